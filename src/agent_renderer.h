@@ -0,0 +1,213 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <SDL.h>
+
+#include "vec2.h"
+#include "camera.h"
+
+// Draws any number of agents, each a body, four sensor rings and a velocity
+// vector, as one triangle list submitted with a single SDL_RenderGeometry
+// call (SDL 2.0.18+). Vertices are rewritten every frame into a buffer that
+// only ever grows, so once it has grown drawing doesn't allocate. Every
+// agent's triangles are the same apart from the vertex offset, so indices
+// are only written the first time that many agents are drawn.
+//
+// Positions are in world coordinates and go through the camera given to
+// begin(). Agents entirely off screen are skipped before any vertex is
+// written, and below pointZoom each agent is only a small square, so the
+// cost follows what is visible rather than the size of the world.
+//
+//     agentRenderer.begin(camera);
+//     for (...) agentRenderer.add(pos, vel, sensorOffset);
+//     agentRenderer.draw(renderer);
+class AgentRenderer {
+	public:
+	static const int SEGMENTS = 8; // sides of each sensor ring and of the body
+	static const int VERTICES_PER_AGENT = 4 * 2 * SEGMENTS + (SEGMENTS + 1) + 4;
+	static const int INDICES_PER_AGENT = 4 * 6 * SEGMENTS + 3 * SEGMENTS + 6;
+	static const int VERTICES_PER_POINT = 4;
+	static const int INDICES_PER_POINT = 6;
+
+	float sensorRadius = 7;
+	float ringWidth = 1.5f;
+	float bodyRadius = 3;
+	float velocityScale = 0.25f; // s, so the vector shows where the agent will be
+	float velocityWidth = 1.5f;
+	SDL_Color sensorColour = {240, 240, 240, 255};
+	SDL_Color bodyColour = {240, 240, 240, 255};
+	SDL_Color velocityColour = {220, 50, 50, 255};
+	float pointZoom = 0.35f; // below this zoom agents are drawn as points
+	float pointSize = 2;     // screen px
+
+	AgentRenderer() {
+		for (int k = 0; k < SEGMENTS; k++) {
+			float angle = 2 * (float)M_PI * k / SEGMENTS;
+			unitCircle[k] = Vec2(cosf(angle), sinf(angle));
+		}
+		buildTemplate();
+	}
+
+	// Starts a new frame seen through camera, picking up any change to the
+	// sizes above
+	void begin(const Camera &view) {
+		agents = 0;
+		culled = 0;
+		camera = view;
+		points = camera.zoom < pointZoom;
+		buildTemplate();
+	}
+
+	void reserve(size_t count) {
+		vertices.reserve(count * VERTICES_PER_AGENT);
+		indices.reserve(count * INDICES_PER_AGENT);
+	}
+
+	void add(const Vec2 &worldPos, const Vec2 &worldVel, float worldSensorOffset) {
+		float zoom = camera.zoom;
+		// the sensor rings and the velocity vector reach this far from pos
+		float reach = std::max(worldSensorOffset + sensorRadius, sqrtf(worldVel.magnitude_squared()) * velocityScale);
+		if (!camera.visible(worldPos, points ? pointSize / zoom : reach)) {
+			culled++;
+			return;
+		}
+		Vec2 pos = camera.toScreen(worldPos);
+		if (points) {
+			addPoint(pos);
+			return;
+		}
+		Vec2 vel = worldVel * zoom;
+		float sensorOffset = worldSensorOffset * zoom;
+
+		size_t first = agents * VERTICES_PER_AGENT;
+		if (vertices.size() < first + VERTICES_PER_AGENT) {
+			vertices.resize(first + VERTICES_PER_AGENT);
+		}
+		if (indices.size() < (agents + 1) * INDICES_PER_AGENT) {
+			addIndices(first);
+		}
+		agents++;
+		SDL_Vertex* v = &vertices[first];
+
+		// sensors go from top, clockwise
+		const Vec2 sensors[4] = {Vec2(0, -sensorOffset), Vec2(sensorOffset, 0), Vec2(0, sensorOffset), Vec2(-sensorOffset, 0)};
+		for (int s = 0; s < 4; s++) {
+			Vec2 centre = pos + sensors[s];
+			for (int k = 0; k < 2 * SEGMENTS; k++) *v++ = vertex(centre + ringShape[k], sensorColour);
+		}
+		for (int k = 0; k < SEGMENTS + 1; k++) *v++ = vertex(pos + discShape[k], bodyColour);
+
+		// velocity vector as a quad. Zero velocity gives an empty one
+		Vec2 to = pos + vel * velocityScale;
+		float length = sqrtf(vel.magnitude_squared()) * velocityScale;
+		Vec2 side = length > 0 ? Vec2(-vel.y, vel.x) * (velocityScale * velocityWidth * 0.5f / length) : Vec2(0, 0);
+		*v++ = vertex(pos + side, velocityColour);
+		*v++ = vertex(pos - side, velocityColour);
+		*v++ = vertex(to + side, velocityColour);
+		*v++ = vertex(to - side, velocityColour);
+	}
+
+	void draw(SDL_Renderer* renderer) const {
+		if (agents == 0) return;
+		if (points) {
+			SDL_RenderGeometry(renderer, NULL, vertices.data(), (int)(agents * VERTICES_PER_POINT), pointIndices.data(), (int)(agents * INDICES_PER_POINT));
+		} else {
+			SDL_RenderGeometry(renderer, NULL, vertices.data(), (int)(agents * VERTICES_PER_AGENT), indices.data(), (int)(agents * INDICES_PER_AGENT));
+		}
+	}
+
+	// Agents drawn and agents skipped as off screen since begin()
+	size_t agentCount() const {
+		return agents;
+	}
+
+	size_t culledCount() const {
+		return culled;
+	}
+
+	// Whether this frame draws agents as points
+	bool drawingPoints() const {
+		return points;
+	}
+
+	private:
+	Vec2 unitCircle[SEGMENTS];
+	// One agent's geometry relative to its sensor centres and its position
+	Vec2 ringShape[2 * SEGMENTS]; // outer and inner vertex per side
+	Vec2 discShape[SEGMENTS + 1]; // centre, then the rim
+	int indexShape[INDICES_PER_AGENT];
+	std::vector<SDL_Vertex> vertices;
+	std::vector<int> indices;      // full agents
+	std::vector<int> pointIndices; // points
+	size_t agents = 0; // added since begin()
+	size_t culled = 0; // skipped since begin()
+	Camera camera;
+	bool points = false;
+
+	static SDL_Vertex vertex(const Vec2 &p, SDL_Color colour) {
+		return {{p.x, p.y}, colour, {0, 0}};
+	}
+
+	// The triangles of an agent whose vertices start at first
+	void addIndices(size_t first) {
+		for (int k = 0; k < INDICES_PER_AGENT; k++) indices.push_back(indexShape[k] + (int)first);
+	}
+
+	// A square of pointSize px in the body colour
+	void addPoint(const Vec2 &pos) {
+		size_t first = agents * VERTICES_PER_POINT;
+		if (vertices.size() < first + VERTICES_PER_POINT) {
+			vertices.resize(first + VERTICES_PER_POINT);
+		}
+		if (pointIndices.size() < (agents + 1) * INDICES_PER_POINT) {
+			const int quad[6] = {0, 1, 2, 2, 1, 3};
+			for (int q = 0; q < 6; q++) pointIndices.push_back(quad[q] + (int)first);
+		}
+		agents++;
+		float h = pointSize * 0.5f;
+		SDL_Vertex* v = &vertices[first];
+		*v++ = vertex(pos + Vec2(-h, -h), bodyColour);
+		*v++ = vertex(pos + Vec2(h, -h), bodyColour);
+		*v++ = vertex(pos + Vec2(-h, h), bodyColour);
+		*v++ = vertex(pos + Vec2(h, h), bodyColour);
+	}
+
+	// Shapes in screen px at the camera's zoom. Line widths stay at least
+	// a pixel so zoomed out rings don't vanish
+	void buildTemplate() {
+		float zoom = camera.zoom;
+		float outer = sensorRadius * zoom;
+		float inner = outer - std::max(ringWidth * zoom, 1.0f);
+		for (int k = 0; k < SEGMENTS; k++) {
+			ringShape[2*k] = unitCircle[k] * outer;
+			ringShape[2*k + 1] = unitCircle[k] * std::max(inner, 0.0f);
+			discShape[k + 1] = unitCircle[k] * bodyRadius * zoom;
+		}
+		discShape[0] = Vec2(0, 0);
+
+		int* i = indexShape;
+		// rings: two triangles between each side's pair of vertices and the next
+		for (int s = 0; s < 4; s++) {
+			int base = s * 2 * SEGMENTS;
+			for (int k = 0; k < SEGMENTS; k++) {
+				int next = (k + 1) % SEGMENTS;
+				int quad[6] = {2*k, 2*k + 1, 2*next, 2*next, 2*k + 1, 2*next + 1};
+				for (int q = 0; q < 6; q++) *i++ = base + quad[q];
+			}
+		}
+		// body: a fan around the centre
+		int disc = 4 * 2 * SEGMENTS;
+		for (int k = 0; k < SEGMENTS; k++) {
+			*i++ = disc;
+			*i++ = disc + 1 + k;
+			*i++ = disc + 1 + (k + 1) % SEGMENTS;
+		}
+		// velocity quad
+		int line = disc + SEGMENTS + 1;
+		int quad[6] = {0, 1, 2, 2, 1, 3};
+		for (int q = 0; q < 6; q++) *i++ = line + quad[q];
+	}
+};
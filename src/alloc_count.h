@@ -0,0 +1,226 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <ostream>
+
+// Heap allocation counting, for checking that hot loops don't allocate and
+// for finding the places that do. Counts come from replacing the global
+// operator new, which happens only in a translation unit that defines
+// COUNT_ALLOCATIONS before including this (the bench does; configure with
+// -DALLOC_PROFILE=ON for the app). Every program here is a single
+// translation unit, which keeps that one per program. Without it the
+// counters stay at zero, every check passes and AllocScope does nothing.
+//
+// Allocations and bytes are counted per thread, and per labelled scope
+// (AllocScope), where each allocation goes to the innermost open scope.
+// Scopes live in a fixed table. Each thread gets its own counters on its
+// first allocation, straight from malloc so counting never goes through
+// operator new, and they are kept after the thread exits for the summary
+namespace alloccount {
+	#ifdef COUNT_ALLOCATIONS
+	const bool enabled = true;
+	#else
+	const bool enabled = false;
+	#endif
+
+	const int MAX_SCOPES = 64; // later labels share the last slot
+
+	struct Counters {
+		std::atomic<uint64_t> allocations{0};
+		std::atomic<uint64_t> bytes{0};
+	};
+
+	struct ThreadCounters : Counters {
+		std::atomic<const char*> name{nullptr};
+		ThreadCounters* next = nullptr; // the thread that started counting before this one
+	};
+
+	struct ScopeCounters : Counters {
+		std::atomic<const char*> label{nullptr};
+		std::atomic<uint64_t> entries{0};
+	};
+
+	// Newest thread first, linked through next. Entries are never removed
+	inline std::atomic<ThreadCounters*> threads{nullptr};
+	// For threads that couldn't get their own counters
+	inline ThreadCounters sharedThread;
+	inline ScopeCounters scopes[MAX_SCOPES];
+	inline std::atomic<int> scopeCount{0};
+	inline thread_local ThreadCounters* currentThread = nullptr;
+	inline thread_local ScopeCounters* currentScope = nullptr;
+
+	inline ThreadCounters& thisThread() {
+		if (!currentThread) {
+			void* memory = std::malloc(sizeof(ThreadCounters));
+			if (!memory) return sharedThread;
+			ThreadCounters* counters = new (memory) ThreadCounters();
+			counters->next = threads.load();
+			while (!threads.compare_exchange_weak(counters->next, counters)) {}
+			currentThread = counters;
+		}
+		return *currentThread;
+	}
+
+	// Names the calling thread in the summary. name must outlive the program
+	inline void nameThread(const char* name) {
+		thisThread().name = name;
+	}
+
+	// Allocations made by the calling thread so far
+	inline uint64_t threadAllocations() {
+		return thisThread().allocations.load(std::memory_order_relaxed);
+	}
+
+	// Allocations and bytes over every thread so far
+	inline void totals(uint64_t &allocations, uint64_t &bytes) {
+		allocations = sharedThread.allocations.load(std::memory_order_relaxed);
+		bytes = sharedThread.bytes.load(std::memory_order_relaxed);
+		for (ThreadCounters* t = threads.load(); t; t = t->next) {
+			allocations += t->allocations.load(std::memory_order_relaxed);
+			bytes += t->bytes.load(std::memory_order_relaxed);
+		}
+	}
+
+	// The counters for label, found by pointer or by text, claiming a free
+	// slot the first time a label is seen
+	inline ScopeCounters& scopeFor(const char* label) {
+		for (int s = 0; s < MAX_SCOPES; s++) {
+			const char* existing = scopes[s].label.load();
+			if (!existing && scopes[s].label.compare_exchange_strong(existing, label)) {
+				scopeCount++;
+				return scopes[s];
+			}
+			if (existing == label || strcmp(existing, label) == 0) return scopes[s];
+		}
+		return scopes[MAX_SCOPES - 1];
+	}
+
+	inline void record(size_t size) {
+		ThreadCounters &thread = thisThread();
+		thread.allocations.fetch_add(1, std::memory_order_relaxed);
+		thread.bytes.fetch_add(size, std::memory_order_relaxed);
+		if (currentScope) {
+			currentScope->allocations.fetch_add(1, std::memory_order_relaxed);
+			currentScope->bytes.fetch_add(size, std::memory_order_relaxed);
+		}
+	}
+
+	inline void printThread(std::ostream &out, const ThreadCounters &thread, const char* fallback) {
+		const char* name = thread.name.load();
+		out << "  " << (name ? name : fallback) << ": " << thread.allocations << " allocations, "
+			<< thread.bytes << " bytes" << std::endl;
+	}
+
+	// Oldest first, so the list reads in the order threads started
+	inline void printThreads(std::ostream &out, const ThreadCounters* thread) {
+		if (!thread) return;
+		printThreads(out, thread->next);
+		printThread(out, *thread, "unnamed");
+	}
+
+	// Per thread and per scope totals, for printing at exit
+	inline void printSummary(std::ostream &out) {
+		out << "Heap allocations by thread:" << std::endl;
+		printThreads(out, threads.load());
+		if (sharedThread.allocations) printThread(out, sharedThread, "others");
+		out << "Heap allocations by scope (innermost only):" << std::endl;
+		for (int s = 0; s < std::min(scopeCount.load(), MAX_SCOPES); s++) {
+			uint64_t entries = scopes[s].entries, allocations = scopes[s].allocations;
+			out << "  " << scopes[s].label.load() << ": " << allocations << " allocations, " << scopes[s].bytes << " bytes over "
+				<< entries << " entries (" << (entries ? (double)allocations / entries : 0) << " each)" << std::endl;
+		}
+	}
+}
+
+// Attributes allocations on this thread to label until it closes. Scopes
+// nest; label must outlive the program (a string literal)
+class AllocScope {
+	public:
+	explicit AllocScope(const char* label) {
+		if (!alloccount::enabled) return;
+		previous = alloccount::currentScope;
+		alloccount::currentScope = &alloccount::scopeFor(label);
+		alloccount::currentScope->entries.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	~AllocScope() {
+		if (alloccount::enabled) alloccount::currentScope = previous;
+	}
+
+	AllocScope(const AllocScope&) = delete;
+	AllocScope& operator=(const AllocScope&) = delete;
+
+	private:
+	alloccount::ScopeCounters* previous = nullptr;
+};
+
+// Asserts that nothing allocated on this thread during its lifetime. count()
+// gives the number for builds where assert is compiled out
+class NoAllocations {
+	public:
+	NoAllocations() : start(alloccount::threadAllocations()) {}
+
+	~NoAllocations() {
+		assert(count() == 0 && "heap allocation inside a no-allocation scope");
+	}
+
+	uint64_t count() const {
+		return alloccount::threadAllocations() - start;
+	}
+
+	private:
+	uint64_t start;
+};
+
+#ifdef COUNT_ALLOCATIONS
+
+// The array, nothrow and sized forms all forward to these
+void* operator new(std::size_t size) {
+	alloccount::record(size);
+	void* p = std::malloc(size ? size : 1);
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+
+void* operator new(std::size_t size, std::align_val_t align) {
+	alloccount::record(size);
+	size_t alignment = (size_t)align;
+	// aligned_alloc wants a whole number of alignments
+	void* p = std::aligned_alloc(alignment, size ? (size + alignment - 1) / alignment * alignment : alignment);
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+
+// GCC inlines these into delete expressions and then warns that free() is
+// given a pointer from operator new, which above is just malloc
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+	::operator delete(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t align) noexcept {
+	::operator delete(p, align);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
@@ -0,0 +1,156 @@
+// Offline analysis of a recorded run (PID-Controller --headless --telemetry FILE):
+// step response statistics, power spectra of the error and controller output,
+// and estimated Bode plots of the closed loop (target -> position) and of the
+// controller (error -> control), per axis.
+//
+// Usage: PID-Controller-analyze TELEMETRY [--segment N] [--csv OUT]
+
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <string>
+
+#include "telemetry.h"
+#include "metrics.h"
+#include "spectrum.h"
+
+using namespace std;
+
+double toDecibels(double gain) {
+	return gain > 0 ? 20 * log10(gain) : -INFINITY;
+}
+
+// First frequency where the closed loop gain drops 3 dB below its low frequency
+// gain, ignoring bins the target didn't excite. -1 if it never does
+float bandwidth(const CrossSpectrum &s) {
+	const double MIN_COHERENCE = 0.5;
+	double reference = -1;
+	for (size_t k = 1; k < s.bins(); k++) {
+		if (s.coherence(k) < MIN_COHERENCE) continue;
+		if (reference < 0) {
+			reference = s.gain(k);
+		} else if (s.gain(k) < reference / sqrt(2.0)) {
+			return s.frequency[k];
+		}
+	}
+	return -1;
+}
+
+// Strongest non-DC bin of an auto spectrum
+size_t peakBin(const vector<double> &psd) {
+	size_t peak = 1;
+	for (size_t k = 1; k < psd.size(); k++) {
+		if (psd[k] > psd[peak]) peak = k;
+	}
+	return peak;
+}
+
+int main(int argc, char** args) {
+	string path, csvPath;
+	int segment = 4096;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(args[i], "--segment") == 0 && i + 1 < argc) {
+			segment = atoi(args[++i]);
+		} else if (strcmp(args[i], "--csv") == 0 && i + 1 < argc) {
+			csvPath = args[++i];
+		} else if (path.empty() && args[i][0] != '-') {
+			path = args[i];
+		} else {
+			path.clear();
+			break;
+		}
+	}
+	if (path.empty() || !FFT::isPowerOfTwo(segment)) {
+		cerr << "Usage: " << args[0] << " TELEMETRY [--segment N (power of two)] [--csv OUT]" << endl;
+		return 1;
+	}
+
+	auto start = chrono::steady_clock::now();
+	vector<TelemetrySample> samples;
+	if (!readTelemetry(path, samples)) {
+		cerr << "Error reading telemetry from " << path << endl;
+		return 1;
+	}
+	size_t n = samples.size();
+	if (n < 2) {
+		cerr << "Not enough samples in " << path << endl;
+		return 1;
+	}
+	double duration = samples[n - 1].time - samples[0].time;
+	float sampleRate = (float)((n - 1) / duration);
+	cout << n << " samples, " << duration << " s at " << sampleRate << " Hz" << endl;
+
+	// Step response, measured from the first sample
+	RunMetrics metrics;
+	for (size_t i = 0; i < n; i++) {
+		const TelemetrySample &s = samples[i];
+		float dT = i > 0 ? (float)(s.time - samples[i - 1].time) : 1 / sampleRate;
+		metrics.update(s.time, Vec2(s.targetX, s.targetY), Vec2(s.posX, s.posY), Vec2(s.controlX, s.controlY), dT);
+	}
+	cout << "step response: overshoot " << metrics.overshoot * 100 << "%, rise " << metrics.riseTime
+		<< " s, settling " << metrics.settlingTime << " s, peak error " << metrics.peakError << endl;
+	cout << "costs: ISE " << metrics.ise << ", IAE " << metrics.iae << ", ITAE " << metrics.itae
+		<< ", effort " << metrics.effort << endl;
+
+	// Columns for the spectra
+	vector<float> targetX(n), posX(n), errorX(n), controlX(n);
+	vector<float> targetY(n), posY(n), errorY(n), controlY(n);
+	for (size_t i = 0; i < n; i++) {
+		targetX[i] = samples[i].targetX; targetY[i] = samples[i].targetY;
+		posX[i] = samples[i].posX; posY[i] = samples[i].posY;
+		errorX[i] = samples[i].errorX; errorY[i] = samples[i].errorY;
+		controlX[i] = samples[i].controlX; controlY[i] = samples[i].controlY;
+	}
+	if (n < (size_t)segment) {
+		cerr << "Run shorter than one " << segment << " sample segment, skipping spectra" << endl;
+		return 0;
+	}
+	CrossSpectrum closedLoopX = welch(targetX.data(), posX.data(), n, sampleRate, segment);
+	CrossSpectrum closedLoopY = welch(targetY.data(), posY.data(), n, sampleRate, segment);
+	CrossSpectrum controllerX = welch(errorX.data(), controlX.data(), n, sampleRate, segment);
+	CrossSpectrum controllerY = welch(errorY.data(), controlY.data(), n, sampleRate, segment);
+
+	cout << fixed << setprecision(3);
+	cout << closedLoopX.segments << " segments of " << segment << " samples, "
+		<< closedLoopX.frequency[1] << " Hz resolution" << endl;
+	cout << "error PSD peak: x " << controllerX.frequency[peakBin(controllerX.pxx)]
+		<< " Hz, y " << controllerY.frequency[peakBin(controllerY.pxx)] << " Hz" << endl;
+	cout << "control PSD peak: x " << controllerX.frequency[peakBin(controllerX.pyy)]
+		<< " Hz, y " << controllerY.frequency[peakBin(controllerY.pyy)] << " Hz" << endl;
+	float bandwidthX = bandwidth(closedLoopX), bandwidthY = bandwidth(closedLoopY);
+	if (bandwidthX < 0 && bandwidthY < 0) {
+		cout << "closed loop bandwidth: not measurable (use a scenario that moves the target, e.g. randomwalk)" << endl;
+	} else {
+		cout << "closed loop -3 dB bandwidth: x " << bandwidthX << " Hz, y " << bandwidthY << " Hz" << endl;
+	}
+
+	if (!csvPath.empty()) {
+		FILE* csv = fopen(csvPath.c_str(), "w");
+		if (!csv) {
+			cerr << "Error opening " << csvPath << endl;
+			return 1;
+		}
+		fprintf(csv, "frequency,error_psd_x,error_psd_y,control_psd_x,control_psd_y,"
+			"closed_loop_db_x,closed_loop_deg_x,closed_loop_coherence_x,"
+			"closed_loop_db_y,closed_loop_deg_y,closed_loop_coherence_y,"
+			"controller_db_x,controller_deg_x,controller_db_y,controller_deg_y\n");
+		for (size_t k = 0; k < closedLoopX.bins(); k++) {
+			fprintf(csv, "%g,%g,%g,%g,%g,%g,%g,%g,%g,%g,%g,%g,%g,%g,%g\n", closedLoopX.frequency[k],
+				controllerX.pxx[k], controllerY.pxx[k], controllerX.pyy[k], controllerY.pyy[k],
+				toDecibels(closedLoopX.gain(k)), closedLoopX.phase(k) * 180 / M_PI, closedLoopX.coherence(k),
+				toDecibels(closedLoopY.gain(k)), closedLoopY.phase(k) * 180 / M_PI, closedLoopY.coherence(k),
+				toDecibels(controllerX.gain(k)), controllerX.phase(k) * 180 / M_PI,
+				toDecibels(controllerY.gain(k)), controllerY.phase(k) * 180 / M_PI);
+		}
+		fclose(csv);
+		cout << "wrote " << csvPath << endl;
+	}
+
+	cout << "analysis took " << chrono::duration<double>(chrono::steady_clock::now() - start).count() << " s" << endl;
+	return 0;
+}
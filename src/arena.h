@@ -0,0 +1,88 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Monotonic (bump) allocator for short lived state, such as one run of a
+// sweep. Allocating is a pointer bump, nothing is freed on its own, and
+// reset() drops everything at once while keeping the memory, so once the
+// arena has grown to fit a run, later runs of the same shape never touch the
+// heap. Destructors never run, so only trivially destructible types go in.
+// Not thread safe: give each worker thread its own
+class Arena {
+	public:
+	explicit Arena(size_t chunkSize = 64 * 1024) : chunkSize(chunkSize) {}
+
+	~Arena() {
+		for (Chunk &chunk : chunks) ::operator delete(chunk.data);
+	}
+
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+	// align must be a power of two
+	void* allocate(size_t bytes, size_t align = alignof(std::max_align_t)) {
+		for (; current < chunks.size(); current++, offset = 0) {
+			void* p = bump(chunks[current], bytes, align);
+			if (p) return p;
+		}
+		// out of chunks: only happens while the arena is still growing
+		Chunk chunk;
+		chunk.size = std::max(chunkSize, bytes + align);
+		chunk.data = static_cast<char*>(::operator new(chunk.size));
+		chunks.push_back(chunk);
+		return bump(chunks[current], bytes, align);
+	}
+
+	template<typename T, typename... Args>
+	T* make(Args&&... args) {
+		static_assert(std::is_trivially_destructible<T>::value, "arena objects are never destroyed");
+		return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+	}
+
+	// n default constructed Ts
+	template<typename T>
+	T* makeArray(size_t n) {
+		static_assert(std::is_trivially_destructible<T>::value, "arena objects are never destroyed");
+		T* array = static_cast<T*>(allocate(sizeof(T) * n, alignof(T)));
+		for (size_t i = 0; i < n; i++) new (array + i) T();
+		return array;
+	}
+
+	// Forgets every allocation. The memory stays for reuse
+	void reset() {
+		current = 0;
+		offset = 0;
+	}
+
+	// Bytes held from the heap
+	size_t capacity() const {
+		size_t total = 0;
+		for (const Chunk &chunk : chunks) total += chunk.size;
+		return total;
+	}
+
+	private:
+	struct Chunk {
+		char* data;
+		size_t size;
+	};
+
+	size_t chunkSize;
+	std::vector<Chunk> chunks;
+	size_t current = 0; // chunk being filled
+	size_t offset = 0;  // bytes used in it
+
+	void* bump(const Chunk &chunk, size_t bytes, size_t align) {
+		uintptr_t base = (uintptr_t)chunk.data;
+		size_t start = (size_t)(((base + offset + align - 1) & ~(uintptr_t)(align - 1)) - base);
+		if (start + bytes > chunk.size) return nullptr;
+		offset = start + bytes;
+		return chunk.data + start;
+	}
+};
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "physics.h"
+#include "noise.h"
+
+// When an agent counts as settled: its error, velocity and integral change
+// all below these for steps steps in a row
+struct SleepThresholds {
+	float error = 0.01f;          // length of (errorX, errorY)
+	float velocity = 0.01f;       // px/s
+	float integralChange = 1e-4f; // per step, length of both integrals' change
+	int steps = 60;
+};
+
+// Many agents chasing one target, stepped SIM_LANES at a time, where agents
+// that have settled on the target go to sleep and cost nothing until the
+// target moves. Awake agents are kept compacted at the front of the block
+// array, so a step only touches ceil(awake / SIM_LANES) blocks.
+// Sensor noise has one channel per slot and sensor, laid out as
+// stepAgentBlock takes it (block, sensor, lane); only the awake blocks'
+// channels are sampled, and an agent's filter state moves with it.
+class AgentBatch {
+	public:
+	SleepThresholds thresholds;
+	SensorNoise noise; // added to every reading, none by default
+
+	explicit AgentBatch(size_t count) :
+		blocks((count + SIM_LANES - 1) / SIM_LANES),
+		slotAgent(blocks.size() * SIM_LANES),
+		agentSlot(count),
+		calm(blocks.size() * SIM_LANES, 0),
+		agents(count),
+		awake(count) {
+		noise.resize(slotAgent.size() * 4);
+		noiseSamples.resize(noise.channels());
+		for (size_t slot = 0; slot < slotAgent.size(); slot++) {
+			slotAgent[slot] = (uint32_t)slot;
+			if (slot < count) agentSlot[slot] = (uint32_t)slot;
+		}
+	}
+
+	size_t size() const {
+		return agents;
+	}
+
+	size_t awakeCount() const {
+		return awake;
+	}
+
+	Vec2 position(size_t agent) const {
+		uint32_t slot = agentSlot[agent];
+		return blocks[slot / SIM_LANES].pos.lane(slot % SIM_LANES);
+	}
+
+	Vec2 velocity(size_t agent) const {
+		uint32_t slot = agentSlot[agent];
+		return blocks[slot / SIM_LANES].vel.lane(slot % SIM_LANES);
+	}
+
+	float sensorOffset(size_t agent) const {
+		uint32_t slot = agentSlot[agent];
+		return blocks[slot / SIM_LANES].sensorOffset[slot % SIM_LANES];
+	}
+
+	// Also wakes the agent
+	void setPosition(size_t agent, const Vec2 &pos) {
+		wakeAll();
+		uint32_t slot = agentSlot[agent];
+		blocks[slot / SIM_LANES].pos.setLane(slot % SIM_LANES, pos);
+	}
+
+	// Any change of target wakes every agent
+	void setTarget(const Vec2 &newTarget) {
+		if (newTarget.x != target.x || newTarget.y != target.y) wakeAll();
+		target = newTarget;
+	}
+
+	void wakeAll() {
+		for (size_t slot = awake; slot < agents; slot++) calm[slot] = 0;
+		awake = agents;
+	}
+
+	void step(float dT) {
+		Vec2Pack targetPack(target);
+		size_t fullBlocks = awake / SIM_LANES;
+		int partialLanes = (int)(awake % SIM_LANES);
+		const size_t BLOCK_CHANNELS = 4 * SIM_LANES;
+		const float* sensorNoise = nullptr;
+		if (noise.kind != SensorNoise::NONE) {
+			size_t awakeBlocks = fullBlocks + (partialLanes > 0);
+			noise.fill(noiseSamples.data(), dT, awakeBlocks * BLOCK_CHANNELS);
+			sensorNoise = noiseSamples.data();
+		}
+		for (size_t b = 0; b < fullBlocks; b++) {
+			stepAgentBlock(blocks[b], targetPack, dT, sensorNoise ? sensorNoise + b * BLOCK_CHANNELS : nullptr);
+		}
+		if (partialLanes > 0) {
+			// the sleeping lanes of the last awake block must not move
+			AgentBlock &block = blocks[fullBlocks];
+			AgentBlock asleep = block;
+			stepAgentBlock(block, targetPack, dT, sensorNoise ? sensorNoise + fullBlocks * BLOCK_CHANNELS : nullptr);
+			for (int lane = partialLanes; lane < SIM_LANES; lane++) swapLanes(block, lane, asleep, lane);
+		}
+		if (++stepCount % CHECK_INTERVAL == 0) updateSleep(dT);
+	}
+
+	private:
+	// Settling is checked every CHECK_INTERVAL steps, which keeps its cost
+	// a small fraction of a step while everything is awake
+	static const int CHECK_INTERVAL = 4;
+
+	struct SettleLimits {
+		float error, velocity;
+		uint32_t steps;
+	};
+
+	std::vector<AgentBlock> blocks;
+	std::vector<uint32_t> slotAgent; // agent in each slot (slot = block * SIM_LANES + lane)
+	std::vector<uint32_t> agentSlot; // and the reverse
+	std::vector<uint32_t> calm;      // steps settled for, per slot
+	size_t agents;
+	size_t awake; // slots [0, awake) are stepped
+	uint64_t stepCount = 0;
+	Vec2 target;
+	std::vector<float> noiseSamples; // this step's noise, one per channel
+
+	void updateSleep(float dT) {
+		const SleepThresholds &t = thresholds;
+		SettleLimits limits;
+		// the integrals change by error * dT a step
+		limits.error = std::min(t.error, t.integralChange / dT);
+		limits.velocity = t.velocity;
+		limits.steps = (uint32_t)std::max(t.steps, 1);
+		size_t fullBlocks = awake / SIM_LANES;
+		int partialLanes = (int)(awake % SIM_LANES);
+		bool anySettled = false;
+		for (size_t b = 0; b < fullBlocks; b++) {
+			anySettled |= countSettled(b, SIM_LANES, limits);
+		}
+		if (partialLanes > 0) anySettled |= countSettled(fullBlocks, partialLanes, limits);
+		if (anySettled) sleepSettled(limits.steps);
+	}
+
+	// Updates the calm counters of block b's first lanes lanes, returning
+	// whether any of them has now been settled long enough to sleep
+	bool countSettled(size_t b, int lanes, const SettleLimits &limits) {
+		const AgentBlock &block = blocks[b];
+		uint32_t* counters = &calm[b * SIM_LANES];
+		// the limits apply to the length of the error and velocity vectors
+		MaskN<SIM_LANES> small = (block.errorX * block.errorX + block.errorY * block.errorY) < FloatPack(limits.error * limits.error);
+		MaskN<SIM_LANES> still = block.vel.magnitude_squared() < FloatPack(limits.velocity * limits.velocity);
+		// masks are all ones or zero, so counting stays branch free and vectorises
+		uint32_t due = 0;
+		for (int lane = 0; lane < SIM_LANES; lane++) {
+			uint32_t settled = (uint32_t)(small.v[lane] & still.v[lane]);
+			counters[lane] = (counters[lane] + CHECK_INTERVAL) & settled;
+			due |= (uint32_t)(counters[lane] >= limits.steps && lane < lanes);
+		}
+		return due != 0;
+	}
+
+	// Swaps every settled agent past the end of the awake range. Walking
+	// down means whatever gets swapped in has been checked already
+	void sleepSettled(uint32_t steps) {
+		for (size_t slot = awake; slot-- > 0;) {
+			if (calm[slot] < steps) continue;
+			size_t last = --awake;
+			if (slot != last) moveSlot(slot, last);
+		}
+	}
+
+	static size_t noiseChannel(size_t slot, int sensor) {
+		return (slot / SIM_LANES * 4 + sensor) * SIM_LANES + slot % SIM_LANES;
+	}
+
+	void moveSlot(size_t a, size_t b) {
+		swapLanes(blocks[a / SIM_LANES], (int)(a % SIM_LANES), blocks[b / SIM_LANES], (int)(b % SIM_LANES));
+		for (int s = 0; s < 4; s++) noise.swapChannels(noiseChannel(a, s), noiseChannel(b, s));
+		std::swap(calm[a], calm[b]);
+		std::swap(slotAgent[a], slotAgent[b]);
+		agentSlot[slotAgent[a]] = (uint32_t)a;
+		agentSlot[slotAgent[b]] = (uint32_t)b;
+	}
+};
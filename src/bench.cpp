@@ -0,0 +1,571 @@
+// Throughput benchmark for the controller and physics path in float and fixed point.
+// Also reports how far the fixed point agents drift from the float reference,
+// which is the quantisation error we'd see on the deployed (FPU-less) targets.
+
+// counts heap allocations for the sweep case, see alloc_count.h
+#define COUNT_ALLOCATIONS
+
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <thread>
+
+#include "physics.h"
+#include "batch.h"
+#include "sim_state.h"
+#include "scenario.h"
+#include "stability.h"
+#include "sweep.h"
+#include "heatmap_cache.h"
+#include "tiled_heatmap.h"
+
+using namespace std;
+
+const int NUM_AGENTS = 1024;
+const int NUM_STEPS = 2000;
+const float DT = 1.0f / 60.0f;
+
+// Target trajectory for the physics cases, set with --scenario
+const char* const DEFAULT_SCENARIO = "hold:540,360";
+string scenarioSpec = DEFAULT_SCENARIO;
+
+// Keeps the optimiser from removing the benchmarked loops
+volatile float sink;
+
+// Largest acceptable deviation of each fixed point case from float, in
+// controller output units and world px. main() fails if any is exceeded.
+// The physics bound only holds for DEFAULT_SCENARIO: Q16.16 can't resolve
+// the sensor differences a few hundred px from the light, so agents thrown
+// that far by a moving target lose it where float ones find it again
+const float PID_Q16_BOUND = 1e-2f;
+const float PID_Q24_BOUND = 1e-4f;
+const float PHYSICS_Q16_BOUND = 1e-1f;
+
+// Cases over their bound so far, and other checks that failed
+int failures = 0;
+
+template<typename T>
+double benchPID(vector<float> &outputs) {
+	vector<PIDControllerT<T>> controllers(NUM_AGENTS, PIDControllerT<T>(T(0.25), T(0.1), T(0.1)));
+	outputs.assign(NUM_AGENTS, 0.0f);
+	
+	auto start = chrono::steady_clock::now();
+	for (int step = 0; step < NUM_STEPS; step++) {
+		// small errors so Q8.24 stays inside its range
+		T error = T(sinf(step * 0.01f));
+		for (int a = 0; a < NUM_AGENTS; a++) {
+			outputs[a] = (float)controllers[a].update(error, T(DT));
+		}
+	}
+	auto end = chrono::steady_clock::now();
+	sink = outputs[0];
+	return chrono::duration<double>(end - start).count();
+}
+
+template<typename T>
+double benchPhysics(vector<Vec2> &positions) {
+	vector<AgentT<T>> agents(NUM_AGENTS);
+	for (int a = 0; a < NUM_AGENTS; a++) {
+		agents[a].pos = Vec2T<T>(T(100 + a % 32 * 25), T(100 + a / 32 * 15));
+	}
+	unique_ptr<Scenario> scenario = makeScenario(scenarioSpec);
+	
+	auto start = chrono::steady_clock::now();
+	for (int step = 0; step < NUM_STEPS; step++) {
+		Vec2 next = scenario->next(DT);
+		Vec2T<T> target(T(next.x), T(next.y));
+		for (int a = 0; a < NUM_AGENTS; a++) {
+			stepAgent(agents[a], target, T(DT));
+		}
+	}
+	auto end = chrono::steady_clock::now();
+	
+	positions.resize(NUM_AGENTS);
+	for (int a = 0; a < NUM_AGENTS; a++) {
+		positions[a] = Vec2((float)agents[a].pos.x, (float)agents[a].pos.y);
+	}
+	sink = positions[0].x;
+	return chrono::duration<double>(end - start).count();
+}
+
+// Same scene as benchPhysics<float>, stepped SIM_LANES agents at a time,
+// optionally with sensor noise generated for all agents each step
+double benchPhysicsPacked(vector<Vec2> &positions, SensorNoise::Kind noiseKind = SensorNoise::NONE) {
+	vector<AgentBlock> blocks(NUM_AGENTS / SIM_LANES);
+	SensorNoise noise;
+	noise.kind = noiseKind;
+	noise.sigma = 1e-5f; // small enough for the agents starting furthest out
+	noise.resize(NUM_AGENTS * 4);
+	vector<float> sensorNoise(NUM_AGENTS * 4);
+	for (int a = 0; a < NUM_AGENTS; a++) {
+		blocks[a / SIM_LANES].pos.setLane(a % SIM_LANES, Vec2(100 + a % 32 * 25, 100 + a / 32 * 15));
+	}
+	unique_ptr<Scenario> scenario = makeScenario(scenarioSpec);
+	
+	auto start = chrono::steady_clock::now();
+	for (int step = 0; step < NUM_STEPS; step++) {
+		Vec2Pack target(scenario->next(DT));
+		const float* noisy = nullptr;
+		if (noiseKind != SensorNoise::NONE) {
+			noise.fill(sensorNoise.data(), DT);
+			noisy = sensorNoise.data();
+		}
+		for (size_t b = 0; b < blocks.size(); b++) {
+			stepAgentBlock(blocks[b], target, DT, noisy ? noisy + b * 4 * SIM_LANES : nullptr);
+		}
+	}
+	auto end = chrono::steady_clock::now();
+	
+	positions.resize(NUM_AGENTS);
+	for (size_t b = 0; b < blocks.size(); b++) {
+		blocks[b].pos.store(&positions[b * SIM_LANES]);
+	}
+	sink = positions[0].x;
+	return chrono::duration<double>(end - start).count();
+}
+
+// benchPhysicsPacked's scene through an AgentBatch, so agents that settle on
+// the target stop costing anything until it moves. awakeSteps counts agent
+// updates actually run
+double benchPhysicsSleeping(vector<Vec2> &positions, uint64_t &awakeSteps, SensorNoise::Kind noiseKind = SensorNoise::NONE) {
+	AgentBatch batch(NUM_AGENTS);
+	batch.noise.kind = noiseKind;
+	batch.noise.sigma = 1e-5f;
+	for (int a = 0; a < NUM_AGENTS; a++) {
+		batch.setPosition(a, Vec2(100 + a % 32 * 25, 100 + a / 32 * 15));
+	}
+	unique_ptr<Scenario> scenario = makeScenario(scenarioSpec);
+	awakeSteps = 0;
+	
+	auto start = chrono::steady_clock::now();
+	for (int step = 0; step < NUM_STEPS; step++) {
+		batch.setTarget(scenario->next(DT));
+		awakeSteps += batch.awakeCount();
+		batch.step(DT);
+	}
+	auto end = chrono::steady_clock::now();
+	
+	positions.resize(NUM_AGENTS);
+	for (int a = 0; a < NUM_AGENTS; a++) {
+		positions[a] = batch.position(a);
+	}
+	sink = positions[0].x;
+	return chrono::duration<double>(end - start).count();
+}
+
+// Largest absolute difference from the float reference
+float maxDeviation(const vector<float> &a, const vector<float> &b) {
+	float worst = 0;
+	for (size_t i = 0; i < a.size(); i++) {
+		worst = fmax(worst, fabs(a[i] - b[i]));
+	}
+	return worst;
+}
+
+float maxDeviation(const vector<Vec2> &a, const vector<Vec2> &b) {
+	float worst = 0;
+	for (size_t i = 0; i < a.size(); i++) {
+		worst = fmax(worst, fabs(a[i].x - b[i].x));
+		worst = fmax(worst, fabs(a[i].y - b[i].y));
+	}
+	return worst;
+}
+
+// Branches FORK_RUNS gain variations off one warmed-up state, against
+// re-simulating the warm-up for every run
+const int WARMUP_STEPS = 20000;
+const int BRANCH_STEPS = 600;
+const int FORK_RUNS = 256;
+
+void runBranch(Simulation &sim, int run) {
+	PIDGains gains;
+	gains.p += 0.002f * (run % 16);
+	gains.d += 0.002f * (run / 16);
+	sim.setGains(gains);
+	sim.metrics.reset();
+	for (int step = 0; step < BRANCH_STEPS; step++) {
+		sim.step(Vec2(300, 200), SIM_DT);
+	}
+}
+
+void benchFork(double &forkSeconds, double &replaySeconds, float &deviation) {
+	auto warmUp = [](Simulation &sim) {
+		for (int step = 0; step < WARMUP_STEPS; step++) {
+			sim.step(Vec2(700, 250), SIM_DT);
+		}
+	};
+	
+	auto start = chrono::steady_clock::now();
+	Simulation base;
+	warmUp(base);
+	vector<uint8_t> state;
+	saveState(base, state);
+	vector<float> forked(FORK_RUNS);
+	int best = 0;
+	double bestITAE = 1e30;
+	for (int run = 0; run < FORK_RUNS; run++) {
+		Simulation branch;
+		loadState(branch, state);
+		runBranch(branch, run);
+		forked[run] = (float)branch.agent.pos.x;
+		// only the metrics are kept per run
+		if (branch.metrics.itae < bestITAE) {
+			bestITAE = branch.metrics.itae;
+			best = run;
+		}
+	}
+	forkSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	cout << "best branch by ITAE: run " << best << " (" << defaultfloat << bestITAE << ")" << endl;
+	
+	start = chrono::steady_clock::now();
+	vector<float> replayed(FORK_RUNS);
+	for (int run = 0; run < FORK_RUNS; run++) {
+		Simulation branch;
+		warmUp(branch);
+		runBranch(branch, run);
+		replayed[run] = (float)branch.agent.pos.x;
+	}
+	replaySeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	
+	// forking must continue exactly where the warm-up left off
+	deviation = maxDeviation(forked, replayed);
+}
+
+// Analytic stability check over a gain grid, against simulating one candidate
+// for SCREEN_SECONDS to see whether it diverges
+const int SCREEN_GRID = 256;
+const int SCREEN_SECONDS = 10;
+
+void benchStabilityScreen() {
+	int stable = 0;
+	auto start = chrono::steady_clock::now();
+	for (int a = 0; a < SCREEN_GRID; a++) {
+		for (int b = 0; b < SCREEN_GRID; b++) {
+			PIDGains gains;
+			gains.p = a * 0.02f;
+			gains.i = 0.1f;
+			gains.d = b * 0.002f;
+			stable += isStable(gains);
+		}
+	}
+	double screenSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	
+	start = chrono::steady_clock::now();
+	Simulation sim;
+	for (int step = 0; step < SCREEN_SECONDS / SIM_DT; step++) {
+		sim.step(Vec2(700, 250), SIM_DT);
+	}
+	sink = (float)sim.agent.pos.x;
+	double simSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	
+	int candidates = SCREEN_GRID * SCREEN_GRID;
+	cout << "stability screen: " << stable << "/" << candidates << " stable, "
+		<< defaultfloat << setprecision(3) << screenSeconds / candidates * 1e9 << " ns per candidate vs "
+		<< simSeconds * 1e6 << " us to simulate one for " << SCREEN_SECONDS << "s" << endl;
+}
+
+// A gain sweep split over worker threads, with every run's state coming from
+// its worker's arena, against allocating it from the heap for every run
+const int SWEEP_RUNS = 8192;
+
+SweepCase sweepCase(int run) {
+	SweepCase c;
+	c.gains.p = 0.05f + 0.01f * (run % 64);
+	c.gains.d = 0.005f * (run / 64);
+	return c;
+}
+
+// Same run as SweepWorker::run, with its state allocated per run
+float runOnHeap(const SweepCase &c) {
+	unique_ptr<AgentT<sim_real>> agent(new AgentT<sim_real>());
+	unique_ptr<RunMetrics> metrics(new RunMetrics());
+	vector<Vec2> trajectory(c.steps);
+	agent->pos = Vec2T<sim_real>(c.start.x, c.start.y);
+	agent->xPID.p = agent->yPID.p = c.gains.p;
+	agent->xPID.i = agent->yPID.i = c.gains.i;
+	agent->xPID.d = agent->yPID.d = c.gains.d;
+	Vec2T<sim_real> target(c.target.x, c.target.y);
+	for (int step = 0; step < c.steps; step++) {
+		Vec2T<sim_real> control = stepAgent(*agent, target, sim_real(c.dT));
+		Vec2 pos((float)agent->pos.x, (float)agent->pos.y);
+		trajectory[step] = pos;
+		metrics->update((step + 1) * (double)c.dT, c.target, pos, Vec2((float)control.x, (float)control.y), c.dT);
+	}
+	return (float)metrics->itae;
+}
+
+// Runs fn(worker, run) for every run, run % workers going to each worker thread
+template<typename F>
+double runSweep(int workers, F fn) {
+	auto start = chrono::steady_clock::now();
+	vector<thread> threads;
+	for (int w = 0; w < workers; w++) {
+		threads.emplace_back([=]() {
+			for (int run = w; run < SWEEP_RUNS; run += workers) fn(w, run);
+		});
+	}
+	for (thread &t : threads) t.join();
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+void benchSweep(int workers) {
+	vector<float> heapITAE(SWEEP_RUNS), arenaITAE(SWEEP_RUNS);
+	vector<uint64_t> heapAllocations(workers);
+	double heapSeconds = runSweep(workers, [&](int w, int run) {
+		uint64_t before = alloccount::threadAllocations();
+		heapITAE[run] = runOnHeap(sweepCase(run));
+		heapAllocations[w] += alloccount::threadAllocations() - before;
+	});
+	
+	vector<unique_ptr<SweepWorker>> sweepWorkers;
+	for (int w = 0; w < workers; w++) sweepWorkers.emplace_back(new SweepWorker());
+	vector<uint64_t> arenaAllocations(workers);
+	double arenaSeconds = runSweep(workers, [&](int w, int run) {
+		uint64_t before = alloccount::threadAllocations();
+		arenaITAE[run] = (float)sweepWorkers[w]->run(sweepCase(run)).metrics->itae;
+		arenaAllocations[w] += alloccount::threadAllocations() - before;
+	});
+	
+	uint64_t heapTotal = 0, arenaTotal = 0, stepTotal = 0;
+	for (int w = 0; w < workers; w++) {
+		heapTotal += heapAllocations[w];
+		arenaTotal += arenaAllocations[w];
+		stepTotal += sweepWorkers[w]->stepAllocations;
+	}
+	cout << "sweep of " << SWEEP_RUNS << " runs on " << workers << (workers == 1 ? " worker" : " workers") << ": heap " << fixed << setprecision(1)
+		<< heapSeconds * 1e3 << " ms (" << heapTotal << " allocations) vs arena " << arenaSeconds * 1e3
+		<< " ms (" << arenaTotal << " allocations, " << stepTotal << " in step loops)"
+		<< ", speedup " << fixed << setprecision(2) << heapSeconds / arenaSeconds << "x"
+		<< ", max deviation " << scientific << setprecision(3) << maxDeviation(heapITAE, arenaITAE) << endl;
+	// NoAllocations only asserts, which release builds compile out
+	if (alloccount::enabled && stepTotal != 0) {
+		cerr << "FAIL: " << stepTotal << " heap allocations inside sweep step loops" << endl;
+		failures++;
+	}
+}
+
+// On one worker as well as one per core (up to 8): the arena only pays off
+// once several threads would otherwise contend for malloc
+void benchSweep() {
+	int most = max(1, min((int)thread::hardware_concurrency(), 8));
+	benchSweep(1);
+	if (most > 1) benchSweep(most);
+}
+
+// Cost of running every stage at the physics rate against sampling sensors
+// and running the controllers only as often as real hardware would
+const float MULTIRATE_SECONDS = 100;
+
+double runStages(float sensorHz, float controlHz, float physicsHz) {
+	Simulation sim;
+	StageRates rates;
+	rates.sensorPeriod = 1 / sensorHz;
+	rates.controlPeriod = 1 / controlHz;
+	rates.physicsPeriod = 1 / physicsHz;
+	sim.setRates(rates);
+	auto start = chrono::steady_clock::now();
+	for (int step = 0; step < MULTIRATE_SECONDS / SIM_DT; step++) {
+		sim.step(Vec2(700, 250), SIM_DT);
+	}
+	sink = (float)sim.agent.pos.x;
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+void benchMultiRate() {
+	double single = runStages(480, 480, 480);
+	double mixed = runStages(60, 120, 480);
+	cout << "stage rates for " << defaultfloat << MULTIRATE_SECONDS << "s: all at 480 Hz " << setprecision(3) << single * 1e3
+		<< " ms vs sensors 60 Hz, control 120 Hz, physics 480 Hz " << mixed * 1e3 << " ms" << endl;
+}
+
+// Accuracy of each integrator against a tight Dormand-Prince reference for
+// a step response, at increasing step sizes. Every step size must stay
+// within the method's bound, large ones included
+const float ACCURACY_SECONDS = 3;
+
+Vec2 integrateStep(const char* integrator, float dT, float tolerance, uint64_t &substeps) {
+	Simulation sim;
+	makeIntegrator(integrator, sim.integrator);
+	sim.integrator.tolerance = tolerance;
+	substeps = 0;
+	int steps = (int)lround(ACCURACY_SECONDS / dT);
+	for (int step = 0; step < steps; step++) {
+		sim.step(Vec2(700, 250), dT);
+		substeps += sim.integrator.substeps;
+	}
+	return Vec2((float)sim.agent.pos.x, (float)sim.agent.pos.y);
+}
+
+void benchIntegrators() {
+	uint64_t substeps;
+	Vec2 reference = integrateStep("dopri", 1.0f / 960, 1e-6f, substeps);
+	cout << "integrator accuracy after a " << ACCURACY_SECONDS << "s step response (continuous model):" << endl;
+	cout << left << setw(10) << "method" << right << setw(10) << "dt" << setw(16) << "substeps/s" << setw(14) << "error px" << endl;
+	const char* integrators[] = {"euler", "rk4", "dopri"};
+	const float bounds[] = {2, 0.1f, 0.1f}; // px
+	const float dTs[] = {1.0f / 480, 1.0f / 120, 1.0f / 30, 1.0f / 10};
+	for (int method = 0; method < 3; method++) {
+		for (float dT : dTs) {
+			Vec2 end = integrateStep(integrators[method], dT, 1e-3f, substeps);
+			float error = sqrtf((end - reference).magnitude_squared());
+			cout << left << setw(10) << integrators[method] << right << setw(10) << defaultfloat << setprecision(4) << dT
+				<< setw(16) << substeps / ACCURACY_SECONDS << setw(14) << setprecision(3) << error;
+			if (!(error <= bounds[method])) {
+				cout << "  FAIL, bound " << bounds[method];
+				failures++;
+			}
+			cout << endl;
+		}
+	}
+}
+
+// Generating a full resolution heatmap against mapping it from the cache
+// on a later start, in a scratch cache directory
+void benchHeatmapCache() {
+	HeatmapParams params;
+	params.resolution = 2160;
+	params.sampleStep = 1;
+	string directory = (filesystem::temp_directory_path() / ("pid-heatmap-bench-" + to_string(heatmapcache::processId()))).string();
+	HeatmapCache cache(directory);
+	
+	auto start = chrono::steady_clock::now();
+	HeatmapImage generated = cache.load(params); // misses, generates and stores
+	double generateSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	start = chrono::steady_clock::now();
+	HeatmapImage mapped = cache.load(params);
+	uint32_t checksum = 0;
+	for (int i = 0; i < mapped.width * mapped.height; i += 1024) checksum += mapped.pixels()[i]; // touch every page
+	double mapSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	sink = (float)checksum;
+	
+	bool same = mapped.fromCache() && memcmp(generated.pixels(), mapped.pixels(), (size_t)mapped.width * mapped.height * 4) == 0;
+	cout << "heatmap " << params.resolution << "x" << params.resolution << ": generate and store " << fixed << setprecision(2) << generateSeconds * 1e3
+		<< " ms vs cached " << mapSeconds * 1e3 << " ms (" << (same ? "identical" : "MISMATCH") << ")" << endl;
+	error_code error;
+	filesystem::remove_all(directory, error);
+}
+
+// Moving one of several lights over a large world: recomputing every tile
+// against only the tiles it dirtied. Lit densely so the field itself costs
+const int FIELD_LIGHTS = 8;
+const int FIELD_FRAMES = 60;
+
+double runField(bool everyTile, uint64_t &tiles, vector<uint32_t> &pixels) {
+	HeatmapParams params;
+	params.sampleStep = 1;
+	TiledHeatmap field(params, Vec2(0, 0), 2, 2048, 2048);
+	for (int l = 0; l < FIELD_LIGHTS; l++) field.addLight(Vec2(600.0f + 900 * (l % 4), 1000.0f + 2000 * (l / 4)));
+	uint32_t checksum = 0;
+	auto upload = [&](const TileRect &rect, const uint32_t* tile, int pitch) {
+		checksum += tile[(rect.h / 2) * (pitch / 4) + rect.w / 2];
+	};
+	field.update(upload);
+	uint64_t before = field.tilesUpdated;
+	auto start = chrono::steady_clock::now();
+	for (int f = 0; f < FIELD_FRAMES; f++) {
+		field.moveLight(0, field.light(0) + Vec2(2, 1));
+		if (everyTile) field.invalidate();
+		field.update(upload);
+	}
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	sink = (float)checksum;
+	tiles = field.tilesUpdated - before;
+	pixels.assign(field.pixels(), field.pixels() + (size_t)field.width() * field.height());
+	return seconds;
+}
+
+void benchTiledHeatmap() {
+	uint64_t allTiles, dirtyTiles;
+	vector<uint32_t> allPixels, dirtyPixels;
+	double all = runField(true, allTiles, allPixels);
+	double dirty = runField(false, dirtyTiles, dirtyPixels);
+	cout << "field of " << FIELD_LIGHTS << " lights, one moving, " << FIELD_FRAMES << " frames: every tile " << fixed << setprecision(2)
+		<< all * 1e3 / FIELD_FRAMES << " ms/frame (" << allTiles / FIELD_FRAMES << " tiles) vs dirty tiles " << dirty * 1e3 / FIELD_FRAMES
+		<< " ms/frame (" << dirtyTiles / FIELD_FRAMES << " tiles, " << (allPixels == dirtyPixels ? "identical" : "MISMATCH") << ")" << endl;
+}
+
+void report(const char* name, double seconds, float deviation, float bound = INFINITY) {
+	double updates = (double)NUM_AGENTS * NUM_STEPS;
+	cout << left << setw(22) << name
+		<< right << setw(10) << fixed << setprecision(2) << updates / seconds / 1e6 << " M/s"
+		<< setw(16) << scientific << setprecision(3) << deviation;
+	// NaN counts as over
+	if (!(deviation <= bound)) {
+		cout << "  FAIL, bound " << bound;
+		failures++;
+	}
+	cout << endl;
+}
+
+int main(int argc, char** args) {
+	if (argc == 3 && string(args[1]) == "--scenario") {
+		scenarioSpec = args[2];
+	} else if (argc != 1) {
+		cerr << "Usage: " << args[0] << " [--scenario NAME]" << endl;
+		cerr << "Scenarios: " << scenarioNames() << endl;
+		return 1;
+	}
+	if (!makeScenario(scenarioSpec)) {
+		cerr << "Unknown scenario " << scenarioSpec << ", expected one of: " << scenarioNames() << endl;
+		return 1;
+	}
+	cout << "scenario " << scenarioSpec << ", ";
+	cout << NUM_AGENTS << " agents x " << NUM_STEPS << " steps" << endl;
+	cout << left << setw(22) << "case" << right << setw(14) << "throughput" << setw(16) << "max deviation" << endl;
+	
+	vector<float> pidFloat, pidQ16, pidQ24;
+	double t = benchPID<float>(pidFloat);
+	report("PID float", t, 0);
+	t = benchPID<Q16_16>(pidQ16);
+	report("PID Q16.16", t, maxDeviation(pidFloat, pidQ16), PID_Q16_BOUND);
+	t = benchPID<Q8_24>(pidQ24);
+	report("PID Q8.24", t, maxDeviation(pidFloat, pidQ24), PID_Q24_BOUND);
+	
+	// Q8.24 can't hold pixel positions, so the full physics path is float vs Q16.16 only
+	vector<Vec2> physFloat, physQ16, physPacked;
+	t = benchPhysics<float>(physFloat);
+	report("physics float", t, 0);
+	t = benchPhysics<Q16_16>(physQ16);
+	report("physics Q16.16", t, maxDeviation(physFloat, physQ16), scenarioSpec == DEFAULT_SCENARIO ? PHYSICS_Q16_BOUND : INFINITY);
+	t = benchPhysicsPacked(physPacked);
+	report("physics float packed", t, maxDeviation(physFloat, physPacked));
+	// deviation here is the effect of the noise itself
+	vector<Vec2> physNoisy;
+	t = benchPhysicsPacked(physNoisy, SensorNoise::GAUSSIAN);
+	report("packed + gaussian", t, maxDeviation(physFloat, physNoisy));
+	t = benchPhysicsPacked(physNoisy, SensorNoise::PINK);
+	report("packed + pink", t, maxDeviation(physFloat, physNoisy));
+	// deviation from plain packed is what freezing settled agents costs
+	vector<Vec2> physSleeping;
+	uint64_t awakeSteps;
+	t = benchPhysicsSleeping(physSleeping, awakeSteps);
+	report("packed + sleeping", t, maxDeviation(physPacked, physSleeping));
+	cout << "  " << fixed << setprecision(1) << 100.0 * awakeSteps / ((double)NUM_AGENTS * NUM_STEPS) << "% of agent steps awake" << endl;
+	vector<Vec2> physSleepingNoisy;
+	t = benchPhysicsSleeping(physSleepingNoisy, awakeSteps, SensorNoise::GAUSSIAN);
+	report("sleeping + gaussian", t, maxDeviation(physSleeping, physSleepingNoisy));
+	cout << "  " << fixed << setprecision(1) << 100.0 * awakeSteps / ((double)NUM_AGENTS * NUM_STEPS) << "% of agent steps awake" << endl;
+	
+	double forkSeconds, replaySeconds;
+	float forkDeviation;
+	benchFork(forkSeconds, replaySeconds, forkDeviation);
+	cout << FORK_RUNS << " what-if runs from a " << WARMUP_STEPS << " step warm-up: "
+		<< fixed << setprecision(3) << forkSeconds << "s forked vs " << replaySeconds << "s replayed"
+		<< ", max deviation " << scientific << forkDeviation << endl;
+	
+	benchStabilityScreen();
+	benchSweep();
+	benchMultiRate();
+	benchIntegrators();
+	benchHeatmapCache();
+	benchTiledHeatmap();
+	
+	if (failures) {
+		cerr << failures << " check(s) failed, see above" << endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <algorithm>
+
+#include "vec2.h"
+
+// Maps world coordinates (what the simulation uses, in px at zoom 1) to the
+// screen: centre is the world point in the middle of the viewport, and zoom
+// the screen px per world px. The default shows the original 1080x720 world
+// exactly as before
+struct Camera {
+	static constexpr float MIN_ZOOM = 0.02f;
+	static constexpr float MAX_ZOOM = 50.0f;
+
+	Vec2 centre = Vec2(1080/2, 720/2);
+	float zoom = 1;
+	int width = 1080, height = 720; // viewport, screen px
+
+	Vec2 toScreen(const Vec2 &world) const {
+		return (world - centre) * zoom + Vec2(width * 0.5f, height * 0.5f);
+	}
+
+	Vec2 toWorld(const Vec2 &screen) const {
+		return (screen - Vec2(width * 0.5f, height * 0.5f)) / zoom + centre;
+	}
+
+	// Whether a circle around a world point shows on screen at all
+	bool visible(const Vec2 &world, float worldRadius) const {
+		Vec2 s = toScreen(world);
+		float r = worldRadius * zoom;
+		return s.x + r >= 0 && s.x - r <= width && s.y + r >= 0 && s.y - r <= height;
+	}
+
+	// Visible world area, as its top left and bottom right corners
+	void worldBounds(Vec2 &topLeft, Vec2 &bottomRight) const {
+		topLeft = toWorld(Vec2(0, 0));
+		bottomRight = toWorld(Vec2((float)width, (float)height));
+	}
+
+	// Moves the view by a drag of screenDelta px
+	void pan(const Vec2 &screenDelta) {
+		centre -= screenDelta / zoom;
+	}
+
+	// Zooms by factor, keeping the world point under screenPoint where it is
+	void zoomAt(const Vec2 &screenPoint, float factor) {
+		Vec2 anchor = toWorld(screenPoint);
+		zoom = std::min(std::max(zoom * factor, MIN_ZOOM), MAX_ZOOM);
+		centre = anchor - (screenPoint - Vec2(width * 0.5f, height * 0.5f)) / zoom;
+	}
+};
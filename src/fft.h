@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "vec2xn.h"
+
+// In place radix-2 complex FFT on split real/imaginary arrays.
+// Split arrays let each butterfly stage run SIM_LANES butterflies at once
+// with FloatPack; the first few stages (fewer than SIM_LANES butterflies per
+// group) run scalar. Sizes must be powers of two, which is all the Welch
+// spectra in spectrum.h need.
+class FFT {
+	public:
+	FFT(int n) : n(n) {
+		bitReverse.resize(n);
+		int bits = 0;
+		while ((1 << bits) < n) bits++;
+		for (int i = 0; i < n; i++) {
+			int r = 0;
+			for (int b = 0; b < bits; b++) {
+				if (i & (1 << b)) r |= 1 << (bits - 1 - b);
+			}
+			bitReverse[i] = r;
+		}
+
+		// Twiddles for every stage, stage with half size h at offset h - 1
+		twiddleRe.resize(n > 1 ? n - 1 : 1);
+		twiddleIm.resize(n > 1 ? n - 1 : 1);
+		for (int h = 1; h < n; h *= 2) {
+			for (int j = 0; j < h; j++) {
+				double angle = -M_PI * j / h;
+				twiddleRe[h - 1 + j] = (float)cos(angle);
+				twiddleIm[h - 1 + j] = (float)sin(angle);
+			}
+		}
+	}
+
+	static bool isPowerOfTwo(int n) {
+		return n > 0 && (n & (n - 1)) == 0;
+	}
+
+	int size() const {
+		return n;
+	}
+
+	// Forward transform, X[k] = sum x[t] e^(-2 pi i k t / n)
+	void forward(float* re, float* im) const {
+		for (int i = 0; i < n; i++) {
+			int r = bitReverse[i];
+			if (r > i) {
+				std::swap(re[i], re[r]);
+				std::swap(im[i], im[r]);
+			}
+		}
+
+		for (int h = 1; h < n; h *= 2) {
+			const float* wr = &twiddleRe[h - 1];
+			const float* wi = &twiddleIm[h - 1];
+			for (int start = 0; start < n; start += 2 * h) {
+				float* aRe = re + start;
+				float* aIm = im + start;
+				float* bRe = aRe + h;
+				float* bIm = aIm + h;
+				int j = 0;
+				if (h >= SIM_LANES) {
+					for (; j < h; j += SIM_LANES) {
+						FloatPack xr = FloatPack::load(bRe + j), xi = FloatPack::load(bIm + j);
+						FloatPack tr = FloatPack::load(wr + j), ti = FloatPack::load(wi + j);
+						FloatPack pr = xr * tr - xi * ti;
+						FloatPack pi = xr * ti + xi * tr;
+						FloatPack ar = FloatPack::load(aRe + j), ai = FloatPack::load(aIm + j);
+						(ar - pr).store(bRe + j);
+						(ai - pi).store(bIm + j);
+						(ar + pr).store(aRe + j);
+						(ai + pi).store(aIm + j);
+					}
+				}
+				for (; j < h; j++) {
+					float pr = bRe[j] * wr[j] - bIm[j] * wi[j];
+					float pi = bRe[j] * wi[j] + bIm[j] * wr[j];
+					bRe[j] = aRe[j] - pr;
+					bIm[j] = aIm[j] - pi;
+					aRe[j] += pr;
+					aIm[j] += pi;
+				}
+			}
+		}
+	}
+
+	private:
+	int n;
+	std::vector<int> bitReverse;
+	std::vector<float> twiddleRe, twiddleIm;
+};
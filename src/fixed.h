@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+// Signed 32 bit fixed point number with FracBits fractional bits.
+// Models the integer-only maths of the microcontrollers the controller is
+// deployed on. Every operation saturates instead of wrapping, like the DSP
+// instructions on those parts, so overflow shows up as clipping in the sim.
+template<int FracBits>
+class Fixed {
+	public:
+	static_assert(FracBits > 0 && FracBits < 31, "Fixed needs between 1 and 30 fractional bits");
+	static constexpr int32_t one = int32_t(1) << FracBits;
+	
+	int32_t raw;
+	
+	Fixed() : raw(0) {}
+	
+	// Converts from any arithmetic type, saturating at the representable range
+	template<typename A, typename = typename std::enable_if<std::is_arithmetic<A>::value>::type>
+	Fixed(A value) {
+		raw = saturate((double)value * one);
+	}
+	
+	static Fixed fromRaw(int32_t r) {
+		Fixed f;
+		f.raw = r;
+		return f;
+	}
+	
+	static Fixed max() { return fromRaw(std::numeric_limits<int32_t>::max()); }
+	static Fixed min() { return fromRaw(std::numeric_limits<int32_t>::min()); }
+	
+	explicit operator float() const { return (float)raw / one; }
+	explicit operator double() const { return (double)raw / one; }
+	
+	Fixed operator+(const Fixed& other) const { return fromRaw(saturate((int64_t)raw + other.raw)); }
+	Fixed operator-(const Fixed& other) const { return fromRaw(saturate((int64_t)raw - other.raw)); }
+	Fixed operator-() const { return fromRaw(saturate(-(int64_t)raw)); }
+	
+	// Products are truncated towards negative infinity, as an arithmetic shift would on target
+	Fixed operator*(const Fixed& other) const {
+		return fromRaw(saturate(((int64_t)raw * other.raw) >> FracBits));
+	}
+	
+	// Division by zero saturates towards the sign of the numerator
+	Fixed operator/(const Fixed& other) const {
+		if (other.raw == 0) {
+			return raw >= 0 ? max() : min();
+		}
+		return fromRaw(saturate(((int64_t)raw * one) / other.raw));
+	}
+	
+	Fixed& operator+=(const Fixed& other) { return *this = *this + other; }
+	Fixed& operator-=(const Fixed& other) { return *this = *this - other; }
+	Fixed& operator*=(const Fixed& other) { return *this = *this * other; }
+	Fixed& operator/=(const Fixed& other) { return *this = *this / other; }
+	
+	bool operator==(const Fixed& other) const { return raw == other.raw; }
+	bool operator!=(const Fixed& other) const { return raw != other.raw; }
+	bool operator<(const Fixed& other) const { return raw < other.raw; }
+	bool operator>(const Fixed& other) const { return raw > other.raw; }
+	bool operator<=(const Fixed& other) const { return raw <= other.raw; }
+	bool operator>=(const Fixed& other) const { return raw >= other.raw; }
+	
+	private:
+	static int32_t saturate(int64_t value) {
+		if (value > std::numeric_limits<int32_t>::max()) return std::numeric_limits<int32_t>::max();
+		if (value < std::numeric_limits<int32_t>::min()) return std::numeric_limits<int32_t>::min();
+		return (int32_t)value;
+	}
+	
+	static int32_t saturate(double value) {
+		if (value >= (double)std::numeric_limits<int32_t>::max()) return std::numeric_limits<int32_t>::max();
+		if (value <= (double)std::numeric_limits<int32_t>::min()) return std::numeric_limits<int32_t>::min();
+		return (int32_t)value;
+	}
+};
+
+typedef Fixed<16> Q16_16; // +-32768 range, ~1.5e-5 resolution. Enough for pixel positions
+typedef Fixed<24> Q8_24;  // +-128 range, ~6e-8 resolution. Controller maths only
+
+// Scalar used by the simulation's controller and physics path, picked at
+// compile time with -DPID_SCALAR=float|Q16_16 (see CMakeLists.txt)
+#if defined(PID_SCALAR_Q16_16)
+typedef Q16_16 sim_real;
+#elif defined(PID_SCALAR_Q8_24)
+#error "Q8_24 can't hold pixel positions or the controller's constants; use float or Q16_16"
+#else
+typedef float sim_real;
+#endif
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Streams RGBA frames to a file or pipe as Y4M (4:4:4) or raw RGBA.
+// Colour conversion and writing happen on a background thread; the capturing
+// thread only copies pixels into a pooled buffer. The pool is bounded so a
+// slow disk eventually applies backpressure instead of eating all memory.
+// A failed write (a full disk, a closed pipe) stops all further output and
+// is reported by failed() and error().
+class FrameWriter {
+	public:
+	enum Format { Y4M, RAW_RGBA };
+
+	FrameWriter(int width, int height, int fps, Format format, int poolSize = 8)
+		: width(width), height(height), fps(fps), format(format) {
+		for (int i = 0; i < poolSize; i++) {
+			freeFrames.push_back(std::vector<uint8_t>(width * height * 4));
+		}
+	}
+
+	~FrameWriter() {
+		close();
+	}
+
+	// path "-" writes to stdout so the stream can be piped into an encoder
+	bool open(const std::string &path) {
+		file = path == "-" ? stdout : fopen(path.c_str(), "wb");
+		if (!file) return false;
+		if (format == Y4M && fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", width, height, fps) < 0) {
+			fail();
+		}
+		running = true;
+		thread = std::thread(&FrameWriter::run, this);
+		return true;
+	}
+
+	// Copies one RGBA frame (R,G,B,A byte order) with the given row pitch into the queue
+	void submit(const uint8_t* pixels, int pitch) {
+		std::vector<uint8_t> frame;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			spaceAvailable.wait(lock, [this] { return !freeFrames.empty(); });
+			frame.swap(freeFrames.back());
+			freeFrames.pop_back();
+		}
+		for (int y = 0; y < height; y++) {
+			memcpy(&frame[y * width * 4], pixels + y * pitch, width * 4);
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			readyFrames.push_back(std::move(frame));
+		}
+		frameReady.notify_one();
+	}
+
+	// Flushes every queued frame and closes the output
+	void close() {
+		if (!running) return;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			running = false;
+		}
+		frameReady.notify_one();
+		thread.join();
+		if ((file != stdout ? fclose(file) : fflush(file)) != 0) fail();
+		file = nullptr;
+	}
+
+	// Frames that reached the output in full
+	uint64_t framesWritten() const {
+		return written;
+	}
+
+	// Whether any write failed. Frames submitted since are dropped
+	bool failed() const {
+		return errorCode != 0;
+	}
+
+	// errno of the first failed write, or 0
+	int error() const {
+		return errorCode;
+	}
+
+	private:
+	int width, height, fps;
+	Format format;
+	FILE* file = nullptr;
+	bool running = false; // guarded by mutex once the thread is up
+	std::atomic<uint64_t> written{0};
+	std::atomic<int> errorCode{0};
+
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable frameReady;
+	std::condition_variable spaceAvailable;
+	std::deque<std::vector<uint8_t>> readyFrames;
+	std::vector<std::vector<uint8_t>> freeFrames;
+	std::vector<uint8_t> planes; // Y4M output, only touched by the writer thread
+
+	void run() {
+		while (true) {
+			std::vector<uint8_t> frame;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				frameReady.wait(lock, [this] { return !readyFrames.empty() || !running; });
+				if (readyFrames.empty()) return;
+				frame.swap(readyFrames.front());
+				readyFrames.pop_front();
+			}
+
+			if (!failed()) {
+				bool ok = format == Y4M ? writeY4MFrame(frame)
+					: fwrite(frame.data(), 1, frame.size(), file) == frame.size();
+				if (ok) written++;
+				else fail();
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				freeFrames.push_back(std::move(frame));
+			}
+			spaceAvailable.notify_one();
+		}
+	}
+
+	// Keeps the first error. Short writes don't always set errno
+	void fail() {
+		int expected = 0;
+		errorCode.compare_exchange_strong(expected, errno ? errno : EIO);
+	}
+
+	// BT.601 limited range, full resolution chroma. False if the write failed
+	bool writeY4MFrame(const std::vector<uint8_t> &rgba) {
+		int n = width * height;
+		planes.resize(n * 3);
+		uint8_t* yPlane = &planes[0];
+		uint8_t* uPlane = &planes[n];
+		uint8_t* vPlane = &planes[n * 2];
+		for (int i = 0; i < n; i++) {
+			int r = rgba[i*4 + 0];
+			int g = rgba[i*4 + 1];
+			int b = rgba[i*4 + 2];
+			yPlane[i] = (uint8_t)((( 66*r + 129*g +  25*b + 128) >> 8) + 16);
+			uPlane[i] = (uint8_t)(((-38*r -  74*g + 112*b + 128) >> 8) + 128);
+			vPlane[i] = (uint8_t)(((112*r -  94*g -  18*b + 128) >> 8) + 128);
+		}
+		return fputs("FRAME\n", file) >= 0 && fwrite(planes.data(), 1, planes.size(), file) == planes.size();
+	}
+};
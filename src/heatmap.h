@@ -0,0 +1,104 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "physics.h"
+#include "vec2.h"
+
+// Everything that decides what the light's heatmap looks like. The texture
+// is centred on the light and covers worldSize world px per side; only the
+// first dotSize texels of every sampleStep each way are lit, which gives the
+// dotted look
+struct HeatmapParams {
+	static const int NUM_COLOURS = 5;
+
+	int resolution = 1080/4; // texels per side
+	float worldSize = 1080;
+	int sampleStep = 5;
+	int dotSize = 1;
+	float maxDistance = 500; // world px from the light, nothing is drawn further out
+	// colours[k] is used at a sensor reading of colourBounds[k], blending in between
+	float colourBounds[NUM_COLOURS] = {0.1f, 0.2f, 0.4f, 0.55f, 0.85f};
+	uint8_t colours[NUM_COLOURS][3] = {
+		{0, 0, 0}, // black
+		{0, 0, 255}, // blue
+		{0, 255, 255}, // cyan
+		{0, 255, 0}, // green
+		{255, 0, 0} // red
+	};
+	// more distance = more transparent
+	float alphaNear = 170;
+	float alphaFalloff = 0.2f; // per world px
+};
+
+// Bump whenever getSensorValueAtPoint() or generateHeatmap() changes what
+// they produce, so cached heatmaps (heatmap_cache.h) stop matching
+const uint32_t HEATMAP_FIELD_VERSION = 2;
+
+// Packs a texel the way SDL_PIXELFORMAT_RGBA8888 stores it
+inline uint32_t heatmapPixel(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+	return (uint32_t)r << 24 | (uint32_t)g << 16 | (uint32_t)b << 8 | a;
+}
+
+// Colour of a lit texel for a summed sensor reading of value, displacement
+// world px from the nearest light
+inline uint32_t heatmapColour(const HeatmapParams &params, float value, float displacement) {
+	const int last = HeatmapParams::NUM_COLOURS - 1;
+	const float* bounds = params.colourBounds;
+	// Find the correct colour bounds. Past the last bound it's the last colour
+	int k = 0;
+	while (k < last && value > bounds[k+1]) {
+		k++;
+	}
+	const uint8_t* from = params.colours[k];
+	const uint8_t* to = params.colours[k < last ? k + 1 : last];
+	float blend = k < last ? (value - bounds[k]) / (bounds[k+1] - bounds[k]) : 0;
+	uint8_t r = (uint8_t)((to[0] - from[0]) * blend + from[0]);
+	uint8_t g = (uint8_t)((to[1] - from[1]) * blend + from[1]);
+	uint8_t b = (uint8_t)((to[2] - from[2]) * blend + from[2]);
+	float alpha = params.alphaNear - params.alphaFalloff * displacement;
+	uint8_t a = (uint8_t)(alpha < 0 ? 0 : alpha > 255 ? 255 : alpha);
+	return heatmapPixel(r, g, b, a);
+}
+
+// Fills a w x h block of texels, rows pitch texels apart, starting at texel
+// (x0, y0) of a field lit by the count lights listed in which. Texel (x, y)
+// sits at origin + (x, y) * worldPerTexel and texel coordinates are never
+// negative. Lights add up: a texel shows the sum of every reachable light's
+// sensor reading, faded by the distance to the nearest. Unlit texels are
+// fully transparent
+inline void generateHeatmapRegion(const HeatmapParams &params, const Vec2* lights, const int* which, int count,
+	const Vec2 &origin, float worldPerTexel, int x0, int y0, int w, int h, uint32_t* pixels, int pitch) {
+	for (int y = 0; y < h; y++) std::fill(pixels + (size_t)y * pitch, pixels + (size_t)y * pitch + w, 0u);
+	if (count == 0) return;
+	int step = params.sampleStep;
+	float maxSquared = params.maxDistance * params.maxDistance;
+	for (int y = y0; y < y0 + h; y++) {
+		if (y % step >= params.dotSize) continue;
+		for (int x = x0; x < x0 + w; x++) {
+			if (x % step >= params.dotSize) continue;
+			Vec2 world = origin + Vec2((float)x, (float)y) * worldPerTexel;
+			float value = 0, nearestSquared = maxSquared;
+			for (int l = 0; l < count; l++) {
+				float squared = (world - lights[which[l]]).magnitude_squared();
+				if (squared >= maxSquared) continue;
+				value += getSensorValueAtPoint(sqrtf(squared));
+				nearestSquared = std::min(nearestSquared, squared);
+			}
+			if (nearestSquared >= maxSquared) continue;
+			pixels[(size_t)(y - y0) * pitch + (x - x0)] = heatmapColour(params, value, sqrtf(nearestSquared));
+		}
+	}
+}
+
+// Fills pixels (resolution x resolution, rows packed) with the heatmap of
+// one light in the middle
+inline void generateHeatmap(const HeatmapParams &params, uint32_t* pixels) {
+	const int n = params.resolution;
+	float worldPerTexel = params.worldSize / n;
+	const Vec2 light(0, 0);
+	const int only = 0;
+	generateHeatmapRegion(params, &light, &only, 1, Vec2(-(n/2) * worldPerTexel, -(n/2) * worldPerTexel), worldPerTexel, 0, 0, n, n, pixels, n);
+}
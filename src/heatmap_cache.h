@@ -0,0 +1,294 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "heatmap.h"
+
+// Generated heatmaps kept on disk between runs. Files are named by a hash of
+// everything that goes into the image (HeatmapParams, HEATMAP_FIELD_VERSION,
+// the pixel byte order), so a changed scene simply misses and old files are
+// never wrong, only unused. Each file is a small header, the full key (checked
+// on load, so a hash collision is a miss too) and the packed RGBA8888 pixels,
+// which are memory-mapped straight into a HeatmapImage:
+//
+//     HeatmapCache cache(HeatmapCache::defaultDirectory());
+//     HeatmapImage image = cache.load(params); // maps the file, or generates and stores it
+//     SDL_UpdateTexture(texture, NULL, image.pixels(), image.width * 4);
+//
+// Files are written under a temporary name and renamed into place, so many
+// processes starting at once can share one directory. An empty directory
+// disables the cache, and then load() just generates.
+namespace heatmapcache {
+	const uint32_t MAGIC = 0x48444950; // "PIDH"
+	const uint32_t VERSION = 1;
+
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t width, height;
+		uint32_t keySize; // key bytes follow the header, then pixels at pixelOffset
+		uint32_t pixelOffset;
+	};
+
+	template<typename T>
+	void put(std::vector<uint8_t> &out, const T &value) {
+		const uint8_t* bytes = (const uint8_t*)&value;
+		out.insert(out.end(), bytes, bytes + sizeof(T));
+	}
+
+	// Everything the pixels depend on, field by field (no struct padding)
+	inline std::vector<uint8_t> key(const HeatmapParams &params) {
+		std::vector<uint8_t> out;
+		put(out, HEATMAP_FIELD_VERSION);
+		put(out, (uint32_t)0x01020304); // pixels are stored in native byte order
+		put(out, params.resolution);
+		put(out, params.worldSize);
+		put(out, params.sampleStep);
+		put(out, params.dotSize);
+		put(out, params.maxDistance);
+		for (int k = 0; k < HeatmapParams::NUM_COLOURS; k++) {
+			put(out, params.colourBounds[k]);
+			for (int c = 0; c < 3; c++) put(out, params.colours[k][c]);
+		}
+		put(out, params.alphaNear);
+		put(out, params.alphaFalloff);
+		return out;
+	}
+
+	// 64 bit FNV-1a
+	inline uint64_t hash(const std::vector<uint8_t> &bytes) {
+		uint64_t h = 14695981039346656037ull;
+		for (uint8_t b : bytes) {
+			h ^= b;
+			h *= 1099511628211ull;
+		}
+		return h;
+	}
+
+	inline int processId() {
+		#ifdef _WIN32
+		return _getpid();
+		#else
+		return (int)getpid();
+		#endif
+	}
+}
+
+// A read-only view of a whole file, memory-mapped where the platform allows
+// and read into memory otherwise
+class MappedFile {
+	public:
+	MappedFile() = default;
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	MappedFile(MappedFile &&other) noexcept {
+		*this = std::move(other);
+	}
+
+	MappedFile& operator=(MappedFile &&other) noexcept {
+		if (this != &other) {
+			close();
+			mapped = other.mapped;
+			length = other.length;
+			buffer = std::move(other.buffer);
+			other.mapped = nullptr;
+			other.length = 0;
+		}
+		return *this;
+	}
+
+	~MappedFile() {
+		close();
+	}
+
+	bool open(const std::string &path) {
+		close();
+		#ifdef _WIN32
+		FILE* file = fopen(path.c_str(), "rb");
+		if (!file) return false;
+		uint8_t chunk[4096];
+		size_t n;
+		while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+			buffer.insert(buffer.end(), chunk, chunk + n);
+		}
+		fclose(file);
+		length = buffer.size();
+		return true;
+		#else
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) return false;
+		struct stat info;
+		if (fstat(fd, &info) != 0 || info.st_size == 0) {
+			::close(fd);
+			return false;
+		}
+		void* p = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd); // the mapping stays valid
+		if (p == MAP_FAILED) return false;
+		mapped = p;
+		length = (size_t)info.st_size;
+		return true;
+		#endif
+	}
+
+	void close() {
+		#ifndef _WIN32
+		if (mapped) munmap(mapped, length);
+		#endif
+		mapped = nullptr;
+		buffer.clear();
+		length = 0;
+	}
+
+	const uint8_t* data() const {
+		return mapped ? (const uint8_t*)mapped : buffer.data();
+	}
+
+	size_t size() const {
+		return length;
+	}
+
+	private:
+	void* mapped = nullptr;
+	size_t length = 0;
+	std::vector<uint8_t> buffer; // when not mapped
+};
+
+// Heatmap pixels, either mapped from a cache file or freshly generated
+class HeatmapImage {
+	public:
+	int width = 0, height = 0;
+
+	const uint32_t* pixels() const {
+		return file.size() ? (const uint32_t*)(file.data() + offset) : generated.data();
+	}
+
+	bool fromCache() const {
+		return file.size() != 0;
+	}
+
+	private:
+	friend class HeatmapCache;
+	MappedFile file;
+	size_t offset = 0;
+	std::vector<uint32_t> generated;
+};
+
+class HeatmapCache {
+	public:
+	// Loads served from disk and loads that had to generate
+	unsigned hits = 0, misses = 0;
+
+	explicit HeatmapCache(const std::string &directory) : directory(directory) {}
+
+	// PID_CONTROLLER_CACHE if set ("" or "off" to disable), otherwise
+	// pid-controller under the user's cache directory
+	static std::string defaultDirectory() {
+		const char* dir = getenv("PID_CONTROLLER_CACHE");
+		if (dir) return strcmp(dir, "off") == 0 ? "" : dir;
+		#ifdef _WIN32
+		dir = getenv("LOCALAPPDATA");
+		if (dir && *dir) return std::string(dir) + "\\pid-controller";
+		#else
+		dir = getenv("XDG_CACHE_HOME");
+		if (dir && *dir) return std::string(dir) + "/pid-controller";
+		dir = getenv("HOME");
+		if (dir && *dir) return std::string(dir) + "/.cache/pid-controller";
+		#endif
+		return "";
+	}
+
+	bool enabled() const {
+		return !directory.empty();
+	}
+
+	std::string pathFor(const HeatmapParams &params) const {
+		char name[40];
+		snprintf(name, sizeof(name), "heatmap-%016llx.px", (unsigned long long)heatmapcache::hash(heatmapcache::key(params)));
+		return (std::filesystem::path(directory) / name).string();
+	}
+
+	HeatmapImage load(const HeatmapParams &params) {
+		HeatmapImage image;
+		image.width = image.height = params.resolution;
+		std::vector<uint8_t> key = heatmapcache::key(params);
+		if (enabled() && map(pathFor(params), key, image)) {
+			hits++;
+			return image;
+		}
+		misses++;
+		image.generated.resize((size_t)params.resolution * params.resolution);
+		generateHeatmap(params, image.generated.data());
+		if (enabled()) store(pathFor(params), key, image);
+		return image;
+	}
+
+	private:
+	std::string directory;
+
+	// Maps path into image if it holds exactly this key's pixels
+	bool map(const std::string &path, const std::vector<uint8_t> &key, HeatmapImage &image) {
+		MappedFile file;
+		if (!file.open(path) || file.size() < sizeof(heatmapcache::Header)) return false;
+		heatmapcache::Header header;
+		memcpy(&header, file.data(), sizeof(header));
+		size_t pixelBytes = (size_t)image.width * image.height * sizeof(uint32_t);
+		if (header.magic != heatmapcache::MAGIC || header.version != heatmapcache::VERSION
+			|| (int)header.width != image.width || (int)header.height != image.height
+			|| header.keySize != key.size() || header.pixelOffset % sizeof(uint32_t) != 0
+			|| header.pixelOffset < sizeof(header) + key.size()
+			|| file.size() != header.pixelOffset + pixelBytes
+			|| memcmp(file.data() + sizeof(header), key.data(), key.size()) != 0) {
+			return false;
+		}
+		image.offset = header.pixelOffset;
+		image.file = std::move(file);
+		return true;
+	}
+
+	// Best effort: a cache that can't be written just keeps missing
+	void store(const std::string &path, const std::vector<uint8_t> &key, const HeatmapImage &image) {
+		std::error_code error;
+		std::filesystem::create_directories(directory, error);
+		if (error) return;
+		heatmapcache::Header header;
+		header.magic = heatmapcache::MAGIC;
+		header.version = heatmapcache::VERSION;
+		header.width = image.width;
+		header.height = image.height;
+		header.keySize = (uint32_t)key.size();
+		header.pixelOffset = (uint32_t)((sizeof(header) + key.size() + 3) / 4 * 4);
+		const uint8_t padding[4] = {0, 0, 0, 0};
+		size_t pixelBytes = image.generated.size() * sizeof(uint32_t);
+
+		std::string temporary = path + ".tmp" + std::to_string(heatmapcache::processId());
+		FILE* file = fopen(temporary.c_str(), "wb");
+		if (!file) return;
+		bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+			&& fwrite(key.data(), 1, key.size(), file) == key.size()
+			&& fwrite(padding, 1, header.pixelOffset - sizeof(header) - key.size(), file) == header.pixelOffset - sizeof(header) - key.size()
+			&& fwrite(image.generated.data(), 1, pixelBytes, file) == pixelBytes;
+		ok = fclose(file) == 0 && ok;
+		if (ok) std::filesystem::rename(temporary, path, error);
+		if (!ok || error) std::filesystem::remove(temporary, error);
+	}
+};
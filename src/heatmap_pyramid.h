@@ -0,0 +1,223 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <SDL.h>
+
+#include "camera.h"
+#include "heatmap.h"
+#include "heatmap_cache.h"
+
+// The light's heatmap at several resolutions, like a mipmap. Level 0 covers
+// WORLD_SIZE world px around the light at COARSE_TEXEL world px per texel,
+// and every further level halves the texel size. Each level is split into
+// TILE x TILE texel tiles with a texture each, and render() draws the level
+// that puts about one texel on each screen px, so zoomed out views sample a
+// few coarse tiles and zoomed in views only ever build the tiles they see.
+//
+// Level 0 is built whole on first use (from the disk cache when it's been
+// built before, see heatmap_cache.h). Finer tiles are generated lazily, at
+// most tileBudget a frame; until a tile exists its area is drawn from the
+// nearest coarser tile that does, and refining() stays true so the caller
+// keeps drawing frames. The field is relative to the light, so tiles
+// stay valid however the light moves. Dots stay the same size in the world
+// on every level, they only get sharper.
+class HeatmapPyramid {
+	public:
+	static const int LEVELS = 6;
+	static const int TILE = 64; // texels per tile side
+	static constexpr float COARSE_TEXEL = 4; // world px per texel on level 0
+	static const int COARSE_TILES = 5; // tiles per side on level 0
+	static constexpr float WORLD_SIZE = COARSE_TILES * TILE * COARSE_TEXEL;
+	static const int MAX_TILES = 2048; // beyond this, tiles not drawn last render are freed
+
+	// Most new tiles a render() generates, 0 for no limit (every frame complete)
+	unsigned tileBudget = 32;
+
+	// Tiles generated and tiles drawn by the last render()
+	unsigned tilesGenerated = 0;
+	unsigned tilesDrawn = 0;
+
+	// style gives the colours and falloff; its sampleStep and dotSize are
+	// for level 0 and scale up on finer levels
+	explicit HeatmapPyramid(const HeatmapParams &style = HeatmapParams()) {
+		for (int l = 0; l < LEVELS; l++) {
+			Level &level = levels[l];
+			level.params = style;
+			level.params.resolution = COARSE_TILES * TILE << l;
+			level.params.worldSize = WORLD_SIZE;
+			level.params.sampleStep = style.sampleStep << l;
+			level.params.dotSize = style.dotSize << l;
+			level.worldPerTexel = COARSE_TEXEL / (1 << l);
+			level.tilesPerSide = COARSE_TILES << l;
+			level.tiles.resize((size_t)level.tilesPerSide * level.tilesPerSide);
+		}
+	}
+
+	HeatmapPyramid(const HeatmapPyramid&) = delete;
+	HeatmapPyramid& operator=(const HeatmapPyramid&) = delete;
+
+	~HeatmapPyramid() {
+		release();
+	}
+
+	// Frees every texture, which must happen before their renderer is destroyed
+	void release() {
+		for (Level &level : levels) {
+			for (Tile &tile : level.tiles) {
+				if (tile.texture) SDL_DestroyTexture(tile.texture);
+				tile.texture = nullptr;
+			}
+		}
+		liveTiles = 0;
+	}
+
+	// Finest level needed for about a texel per screen px at zoom
+	static int levelFor(float zoom) {
+		int level = (int)ceilf(log2f(COARSE_TEXEL * zoom));
+		return std::min(std::max(level, 0), LEVELS - 1);
+	}
+
+	// Whether the last render() drew placeholders for tiles still to be generated
+	bool refining() const {
+		return pending;
+	}
+
+	// Draws the heatmap of a light at light (world) through camera
+	void render(SDL_Renderer* renderer, const Camera &camera, const Vec2 &light) {
+		frame++;
+		tilesGenerated = 0;
+		tilesDrawn = 0;
+		pending = false;
+		if (!ensureCoarse(renderer)) return;
+
+		int l = levelFor(camera.zoom);
+		const Level &level = levels[l];
+		float tileWorld = TILE * level.worldPerTexel;
+		Vec2 origin = light - Vec2(WORLD_SIZE / 2, WORLD_SIZE / 2);
+		Vec2 topLeft, bottomRight;
+		camera.worldBounds(topLeft, bottomRight);
+		int tx0 = std::max(0, (int)floorf((topLeft.x - origin.x) / tileWorld));
+		int ty0 = std::max(0, (int)floorf((topLeft.y - origin.y) / tileWorld));
+		int tx1 = std::min(level.tilesPerSide - 1, (int)floorf((bottomRight.x - origin.x) / tileWorld));
+		int ty1 = std::min(level.tilesPerSide - 1, (int)floorf((bottomRight.y - origin.y) / tileWorld));
+		for (int ty = ty0; ty <= ty1; ty++) {
+			for (int tx = tx0; tx <= tx1; tx++) {
+				// edges rounded on their own so neighbouring tiles meet exactly
+				Vec2 a = camera.toScreen(origin + Vec2(tx * tileWorld, ty * tileWorld));
+				Vec2 b = camera.toScreen(origin + Vec2((tx + 1) * tileWorld, (ty + 1) * tileWorld));
+				SDL_Rect dest = {(int)lroundf(a.x), (int)lroundf(a.y), 0, 0};
+				dest.w = (int)lroundf(b.x) - dest.x;
+				dest.h = (int)lroundf(b.y) - dest.y;
+				drawTile(renderer, l, tx, ty, dest);
+			}
+		}
+		if (liveTiles > MAX_TILES) evict();
+	}
+
+	private:
+	struct Tile {
+		SDL_Texture* texture = nullptr;
+		uint64_t lastDrawn = 0;
+	};
+
+	struct Level {
+		HeatmapParams params;
+		float worldPerTexel;
+		int tilesPerSide;
+		std::vector<Tile> tiles;
+	};
+
+	Level levels[LEVELS];
+	std::vector<uint32_t> scratch = std::vector<uint32_t>(TILE * TILE);
+	uint64_t frame = 0;
+	int liveTiles = 0;
+	bool pending = false;
+
+	SDL_Texture* createTile(SDL_Renderer* renderer, const uint32_t* pixels, int pitch) {
+		SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STATIC, TILE, TILE);
+		if (!texture) return nullptr;
+		SDL_UpdateTexture(texture, NULL, pixels, pitch * (int)sizeof(uint32_t));
+		SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+		liveTiles++;
+		return texture;
+	}
+
+	// Builds level 0 in one go, so every finer tile has something to fall back on
+	bool ensureCoarse(SDL_Renderer* renderer) {
+		Level &level = levels[0];
+		if (level.tiles[0].texture) return true;
+		HeatmapCache cache(HeatmapCache::defaultDirectory());
+		HeatmapImage image = cache.load(level.params);
+		for (int ty = 0; ty < level.tilesPerSide; ty++) {
+			for (int tx = 0; tx < level.tilesPerSide; tx++) {
+				const uint32_t* first = image.pixels() + (size_t)ty * TILE * image.width + tx * TILE;
+				SDL_Texture* texture = createTile(renderer, first, image.width);
+				if (!texture) {
+					// all or nothing, so tile 0 alone says the level is complete
+					for (Tile &tile : level.tiles) {
+						if (!tile.texture) continue;
+						SDL_DestroyTexture(tile.texture);
+						tile.texture = nullptr;
+						liveTiles--;
+					}
+					return false;
+				}
+				level.tiles[ty * level.tilesPerSide + tx].texture = texture;
+			}
+		}
+		return true;
+	}
+
+	void generateTile(SDL_Renderer* renderer, int l, int tx, int ty) {
+		Level &level = levels[l];
+		const Vec2 light(0, 0);
+		const int only = 0;
+		Vec2 origin(-WORLD_SIZE / 2, -WORLD_SIZE / 2);
+		generateHeatmapRegion(level.params, &light, &only, 1, origin, level.worldPerTexel,
+			tx * TILE, ty * TILE, TILE, TILE, scratch.data(), TILE);
+		level.tiles[ty * level.tilesPerSide + tx].texture = createTile(renderer, scratch.data(), TILE);
+		tilesGenerated++;
+	}
+
+	// Draws tile (tx, ty) of level l, generating it if the budget allows and
+	// otherwise standing in the matching part of a coarser tile
+	void drawTile(SDL_Renderer* renderer, int l, int tx, int ty, const SDL_Rect &dest) {
+		Tile &tile = levels[l].tiles[ty * levels[l].tilesPerSide + tx];
+		if (!tile.texture && (tileBudget == 0 || tilesGenerated < tileBudget)) generateTile(renderer, l, tx, ty);
+		if (tile.texture) {
+			tile.lastDrawn = frame;
+			SDL_RenderCopy(renderer, tile.texture, NULL, &dest);
+			tilesDrawn++;
+			return;
+		}
+		pending = true;
+		for (int up = 1; up <= l; up++) {
+			const Level &coarser = levels[l - up];
+			Tile &parent = levels[l - up].tiles[(ty >> up) * coarser.tilesPerSide + (tx >> up)];
+			if (!parent.texture) continue;
+			int size = TILE >> up;
+			SDL_Rect source = {(tx & ((1 << up) - 1)) * size, (ty & ((1 << up) - 1)) * size, size, size};
+			parent.lastDrawn = frame;
+			SDL_RenderCopy(renderer, parent.texture, &source, &dest);
+			tilesDrawn++;
+			return;
+		}
+	}
+
+	// Frees finer tiles that weren't drawn this frame. Level 0 always stays
+	void evict() {
+		for (int l = 1; l < LEVELS; l++) {
+			for (Tile &tile : levels[l].tiles) {
+				if (tile.texture && tile.lastDrawn != frame) {
+					SDL_DestroyTexture(tile.texture);
+					tile.texture = nullptr;
+					liveTiles--;
+				}
+			}
+		}
+	}
+};
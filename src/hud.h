@@ -0,0 +1,102 @@
+#pragma once
+
+#include <charconv>
+#include <cstring>
+#include <type_traits>
+
+#include <SDL.h>
+#include <SDL_ttf.h>
+
+// HUD text without heap allocations: labels are formatted with to_chars into
+// fixed buffers, and each label keeps the texture of its last text, so the
+// font is only rendered again when the text actually changes
+
+// Writes prefix then value into out (to_string's six decimals for floats),
+// truncating to fit. Returns the length, out is always null terminated
+template<typename T>
+size_t formatHud(char* out, size_t size, const char* prefix, T value) {
+	size_t length = strnlen(prefix, size - 1);
+	memcpy(out, prefix, length);
+	char* end = out + size - 1;
+	std::to_chars_result result;
+	if constexpr (std::is_floating_point<T>::value) {
+		result = std::to_chars(out + length, end, value, std::chars_format::fixed, 6);
+	} else {
+		result = std::to_chars(out + length, end, value);
+	}
+	if (result.ec == std::errc()) length = result.ptr - out;
+	out[length] = '\0';
+	return length;
+}
+
+// One line of HUD text and the texture it was last rendered to. The colour
+// is applied when the text is rendered, so keep it the same for a label
+class HudLabel {
+	public:
+	static const size_t MAX_TEXT = 64;
+
+	// How many times the text has been rendered to a texture
+	unsigned renders = 0;
+
+	HudLabel() = default;
+	HudLabel(const HudLabel&) = delete;
+	HudLabel& operator=(const HudLabel&) = delete;
+
+	~HudLabel() {
+		release();
+	}
+
+	// Frees the texture, which must happen before its renderer is destroyed.
+	// The next draw renders the text again
+	void release() {
+		if (texture) SDL_DestroyTexture(texture);
+		texture = nullptr;
+		dirty = true;
+	}
+
+	void setText(const char* newText) {
+		size_t newLength = strnlen(newText, MAX_TEXT - 1);
+		if (newLength == length && memcmp(newText, text, length) == 0) return;
+		memcpy(text, newText, newLength);
+		text[newLength] = '\0';
+		length = newLength;
+		dirty = true;
+	}
+
+	template<typename T>
+	void set(const char* prefix, T value) {
+		char formatted[MAX_TEXT];
+		formatHud(formatted, MAX_TEXT, prefix, value);
+		setText(formatted);
+	}
+
+	// Draws with its top left at x, y, first rendering the text if it changed
+	void draw(SDL_Renderer* renderer, TTF_Font* font, SDL_Color colour, int x, int y) {
+		if (dirty) {
+			release();
+			SDL_Surface* surface = length ? TTF_RenderText_Solid(font, text, colour) : nullptr;
+			if (surface) {
+				texture = SDL_CreateTextureFromSurface(renderer, surface);
+				w = surface->w;
+				h = surface->h;
+				SDL_FreeSurface(surface);
+			}
+			dirty = false;
+			renders++;
+		}
+		if (!texture) return;
+		SDL_Rect dest = {x, y, w, h};
+		SDL_RenderCopy(renderer, texture, NULL, &dest);
+	}
+
+	const char* c_str() const {
+		return text;
+	}
+
+	private:
+	char text[MAX_TEXT] = "";
+	size_t length = 0;
+	bool dirty = true;
+	SDL_Texture* texture = nullptr;
+	int w = 0, h = 0;
+};
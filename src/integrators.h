@@ -0,0 +1,187 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+
+#include "physics.h"
+
+// Continuous time model of an agent, for integrating with larger steps than
+// the sampled controller in stepAgent allows.
+//
+// The PID runs continuously on the sensor error e(p) with the exact error
+// rate (the sensor gradient along the velocity) instead of a backward
+// difference, and its output is an acceleration. Output is scaled by 1/SIM_DT
+// so that one control period of this model matches one stepAgent step:
+//
+//     p' = v,  v' = scale(p) (P e + I integral + D e') / controlPeriod,  integral' = e
+//
+// That scaling makes the model stiff on the scale of one control period, so
+// the fixed step methods below never take a substep longer than that.
+
+struct AgentState {
+	Vec2 pos, vel, integral;
+
+	AgentState operator+(const AgentState &other) const {
+		return {pos + other.pos, vel + other.vel, integral + other.integral};
+	}
+
+	AgentState operator*(float k) const {
+		return {pos * k, vel * k, integral * k};
+	}
+};
+
+struct AgentDynamics {
+	Vec2 target;
+	float p, i, d;
+	float sensorOffset = 20;
+	float controlPeriod;
+
+	// Sensor errors at pos and their rate of change when moving at vel
+	void sensorErrors(const Vec2 &pos, const Vec2 &vel, Vec2 &error, Vec2 &errorRate, float sensorValues[4]) const {
+		// sensor offsets from top, clockwise; distances as seen from each sensor
+		const Vec2 offsets[4] = {Vec2(0, -sensorOffset), Vec2(sensorOffset, 0), Vec2(0, sensorOffset), Vec2(-sensorOffset, 0)};
+		Vec2 targetRate = -vel; // the target is still within a step
+		float rates[4];
+		for (int s = 0; s < 4; s++) {
+			Vec2 d = target - pos - offsets[s];
+			float u = d.magnitude_squared();
+			sensorValues[s] = getSensorValueAtPoint(u);
+			// f(u) = 100/(u + 100), df/du = -100/(u + 100)^2, du/dt = 2 d . d'
+			float slope = -100.0f / ((u + 100) * (u + 100));
+			rates[s] = slope * 2 * (d * targetRate);
+		}
+		error = Vec2(-200 * (sensorValues[3] - sensorValues[1]), 200 * (sensorValues[2] - sensorValues[0]));
+		errorRate = Vec2(-200 * (rates[3] - rates[1]), 200 * (rates[2] - rates[0]));
+	}
+
+	AgentState derivative(const AgentState &state) const {
+		Vec2 error, errorRate;
+		float sensorValues[4];
+		sensorErrors(state.pos, state.vel, error, errorRate, sensorValues);
+		float scale = controlScale(sensorValues);
+		Vec2 control = (error * p + state.integral * i + errorRate * d) * (scale / controlPeriod);
+		return {state.vel, control, error};
+	}
+};
+
+// Integration method for Simulation::step. DISCRETE is the sampled controller
+// of stepAgent (the default, and what the deployed firmware does); the rest
+// integrate the continuous model above. Plain data so it copies and saves
+// with the simulation.
+//
+// SEMI_IMPLICIT_EULER and RK4 split a dT longer than the control period into
+// equal substeps no longer than it: at dT = 4 control periods one RK4 step
+// is already unstable (errors of 1000 px and more). DORMAND_PRINCE picks its
+// own substeps.
+struct Integrator {
+	enum Kind { DISCRETE, SEMI_IMPLICIT_EULER, RK4, DORMAND_PRINCE };
+
+	Kind kind = DISCRETE;
+	float tolerance = 1e-3f; // DORMAND_PRINCE error per step, px
+	float substep = 0;       // DORMAND_PRINCE's next trial substep, 0 until first used
+	uint32_t substeps = 0;   // substeps taken by the last advance()
+
+	// Advances state by exactly dT
+	void advance(const AgentDynamics &dynamics, AgentState &state, float dT) {
+		switch (kind) {
+			case SEMI_IMPLICIT_EULER:
+			case RK4: {
+				substeps = fixedSubsteps(dynamics, dT);
+				float h = dT / substeps;
+				for (uint32_t n = 0; n < substeps; n++) {
+					if (kind == RK4) advanceRK4(dynamics, state, h);
+					else advanceSemiImplicitEuler(dynamics, state, h);
+				}
+				break;
+			}
+			case DORMAND_PRINCE:
+				advanceDormandPrince(dynamics, state, dT);
+				break;
+			case DISCRETE:
+				break;
+		}
+	}
+
+	private:
+	// Substeps of at most one control period covering dT. The slack keeps a
+	// dT of exactly n periods, give or take rounding, at n substeps
+	static uint32_t fixedSubsteps(const AgentDynamics &dynamics, float dT) {
+		if (!(dynamics.controlPeriod > 0)) return 1;
+		return (uint32_t)std::max(1.0f, ceilf(dT / dynamics.controlPeriod - 1e-3f));
+	}
+
+	static void advanceSemiImplicitEuler(const AgentDynamics &f, AgentState &y, float h) {
+		AgentState rate = f.derivative(y);
+		y.vel += rate.vel * h;
+		y.integral += rate.integral * h;
+		y.pos += y.vel * h;
+	}
+
+	static void advanceRK4(const AgentDynamics &f, AgentState &y, float h) {
+		AgentState k1 = f.derivative(y);
+		AgentState k2 = f.derivative(y + k1 * (h / 2));
+		AgentState k3 = f.derivative(y + k2 * (h / 2));
+		AgentState k4 = f.derivative(y + k3 * h);
+		y = y + (k1 + k2 * 2 + k3 * 2 + k4) * (h / 6);
+	}
+
+	// Local error size in px: position error, or velocity error over 0.1 s if larger
+	static float errorNorm(const AgentState &e) {
+		float pos = std::max(fabsf(e.pos.x), fabsf(e.pos.y));
+		float vel = std::max(fabsf(e.vel.x), fabsf(e.vel.y)) * 0.1f;
+		return std::max(pos, vel);
+	}
+
+	// Dormand-Prince 5(4) with step size control, substepping to land exactly on dT
+	void advanceDormandPrince(const AgentDynamics &f, AgentState &y, float dT) {
+		float t = 0;
+		float h = substep > 0 ? std::min(substep, dT) : dT;
+		substeps = 0;
+		while (t < dT) {
+			bool last = t + h >= dT;
+			if (last) h = dT - t;
+			AgentState k1 = f.derivative(y);
+			AgentState k2 = f.derivative(y + k1 * (h * 1.0f/5));
+			AgentState k3 = f.derivative(y + (k1 * (3.0f/40) + k2 * (9.0f/40)) * h);
+			AgentState k4 = f.derivative(y + (k1 * (44.0f/45) + k2 * (-56.0f/15) + k3 * (32.0f/9)) * h);
+			AgentState k5 = f.derivative(y + (k1 * (19372.0f/6561) + k2 * (-25360.0f/2187) + k3 * (64448.0f/6561) + k4 * (-212.0f/729)) * h);
+			AgentState k6 = f.derivative(y + (k1 * (9017.0f/3168) + k2 * (-355.0f/33) + k3 * (46732.0f/5247) + k4 * (49.0f/176) + k5 * (-5103.0f/18656)) * h);
+			AgentState y5 = y + (k1 * (35.0f/384) + k3 * (500.0f/1113) + k4 * (125.0f/192) + k5 * (-2187.0f/6784) + k6 * (11.0f/84)) * h;
+			AgentState k7 = f.derivative(y5);
+			// difference between the 5th and embedded 4th order solutions
+			AgentState difference = (k1 * (71.0f/57600) + k3 * (-71.0f/16695) + k4 * (71.0f/1920)
+				+ k5 * (-17253.0f/339200) + k6 * (22.0f/525) + k7 * (-1.0f/40)) * h;
+
+			float error = errorNorm(difference) / tolerance;
+			// standard controller: shrink on failure, grow at most 5x on success
+			float factor = error > 0 ? 0.9f * powf(error, -0.2f) : 5.0f;
+			factor = std::min(5.0f, std::max(0.2f, factor));
+			if (error <= 1 || h <= dT * 1e-4f) {
+				y = y5;
+				t = last ? dT : t + h;
+				substeps++;
+				if (!last) substep = h * factor;
+				h *= factor;
+			} else {
+				h *= factor;
+			}
+		}
+	}
+};
+
+// Integrator names accepted by makeIntegrator, for usage messages
+inline const char* integratorNames() {
+	return "discrete euler rk4 dopri";
+}
+
+inline bool makeIntegrator(const std::string &name, Integrator &integrator) {
+	if (name == "discrete") integrator.kind = Integrator::DISCRETE;
+	else if (name == "euler") integrator.kind = Integrator::SEMI_IMPLICIT_EULER;
+	else if (name == "rk4") integrator.kind = Integrator::RK4;
+	else if (name == "dopri") integrator.kind = Integrator::DORMAND_PRINCE;
+	else return false;
+	integrator.substep = 0;
+	return true;
+}
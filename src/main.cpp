@@ -4,231 +4,29 @@
 	#include <limits> // for integer limits to convert integer angle to radians
 	#include <cmath> // for M_PI and trig
 	#include <iostream>
-	#include <sstream>
+	#include <cstring>
+	#include <cerrno>
+	#include <cstdio>
+	#include <csignal>
 
 	#include <SDL.h>          // NOT <SDL2/SDL.h>
-	#include <SDL_image.h>    // NOT <SDL2/SDL_image.h>
 	#include <SDL_ttf.h>      // NOT <SDL2/SDL_ttf.h>
 	
-	using namespace std;
+	#include "sim_thread.h"
+	#include "frame_writer.h"
+	#include "sim_state.h"
+	#include "scenario.h"
+	#include "telemetry.h"
+	#include "hud.h"
+	#include "agent_renderer.h"
+	#include "batch.h"
+	#include "static_layer.h"
+	#include "camera.h"
+	#include "heatmap_pyramid.h"
+	#include "embedded_assets.h" // generated by CMakeLists.txt
+	#include "alloc_count.h"
 	
-	class Vec2 {
-		public: 
-		float x, y;
-		
-		Vec2(float a = 0.0, float b = 0.0) {
-			x = a;
-			y = b;
-		}
-		
-		// Operator overloads
-		// Scalar Vector product using operator*
-		Vec2 operator*(float other) {
-			return Vec2(x * other, y * other);
-		}
-		
-		// Dot product using operator*
-		float operator*(const Vec2& other) const {
-			return (x * other.x) + (y * other.y);
-		}
-		
-		// Vec2 addition using operator+
-		Vec2 operator+(const Vec2& other) const {
-			return Vec2(x + other.x, y + other.y);
-		}
-		
-		// Vec2 += addition using operator+=
-		Vec2& operator+=(const Vec2& other) {
-			x += other.x;
-			y += other.y;
-			return *this;
-		}
-		
-		// Vec2 subtraction using operator-
-		Vec2 operator-(const Vec2& other) const {
-			return Vec2(x - other.x, y - other.y);
-		}
-		
-		// Vec2 unary subtraction using operator-
-		Vec2 operator-() const {
-			return Vec2(-x, -y);
-		}
-		
-		// Scalar Vector quotient using operator/
-		Vec2 operator/(float other) {
-			return Vec2(x / other, y / other);
-		}
-		
-		float magnitude_squared() {
-			return x*x + y*y;
-		}
-	};
-
-class LineGraph {
-private:
-    float maxValue = -10000000.0f; // initialise to minimum expected value 
-    float minValue = 10000000.0f;  // initialise to maximum expected value
-    Vec2 position;                 // top left of graph space
-    vector<float> values;
-    
-    // SDL2 specific text handling
-    SDL_Renderer* renderer = nullptr;
-    TTF_Font* font = nullptr;
-    
-    SDL_Texture* titleTexture = nullptr;
-    SDL_Texture* maxLabelTexture = nullptr;
-    SDL_Texture* minLabelTexture = nullptr;
-    
-    SDL_Rect titleRect = {0,0,0,0};
-    SDL_Rect maxRect = {0,0,0,0};
-    SDL_Rect minRect = {0,0,0,0};
-
-    float graphWidth = 475.0f;
-    float graphHeight = 150.0f;
-    int padding = 5;
-
-    // Helper to create a texture from string
-    SDL_Texture* createTextTexture(string text, SDL_Rect &rect) {
-        if (!font || !renderer) return nullptr;
-        
-        SDL_Color textColor = {0, 0, 0, 255}; // Black text
-        SDL_Surface* surface = TTF_RenderText_Solid(font, text.c_str(), textColor);
-        if (!surface) return nullptr;
-        
-        SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-        rect.w = surface->w;
-        rect.h = surface->h;
-        
-        SDL_FreeSurface(surface);
-        return texture;
-    }
-    
-public:
-    // Constructor requires Renderer and Font to generate labels
-    LineGraph(Vec2 position1, string graphTitleName, SDL_Renderer* linkedRenderer, TTF_Font* linkedFont) 
-        : position(position1), renderer(linkedRenderer), font(linkedFont) {
-        
-        // Generate Title Texture immediately
-        titleTexture = createTextTexture(graphTitleName, titleRect);
-        
-        // Position title: Center middle above graph
-        // Note: We use existing rect.w/h calculated in createTextTexture
-        titleRect.x = (int)(position.x + graphWidth/2 - titleRect.w/2);
-        titleRect.y = (int)(position.y - titleRect.h - 5); 
-
-        // Initial placeholder labels
-        updateLabels();
-    }
-
-    LineGraph() { 
-        // Empty constructor
-    }
-
-    // Destructor to clean up textures
-    ~LineGraph() {
-        if (titleTexture) SDL_DestroyTexture(titleTexture);
-        if (maxLabelTexture) SDL_DestroyTexture(maxLabelTexture);
-        if (minLabelTexture) SDL_DestroyTexture(minLabelTexture);
-    }
-    
-    void updateLabels() {
-        // Clear old textures
-        if (maxLabelTexture) SDL_DestroyTexture(maxLabelTexture);
-        if (minLabelTexture) SDL_DestroyTexture(minLabelTexture);
-
-        // Round strings
-        std::ostringstream minStream, maxStream;
-        
-        // Handle cases where no data exists yet
-        float displayMin = (minValue == 10000000.0f) ? 0 : minValue;
-        float displayMax = (maxValue == -10000000.0f) ? 0 : maxValue;
-
-        minStream << round(displayMin);
-        maxStream << round(displayMax);
-
-        // Generate new textures
-        minLabelTexture = createTextTexture(minStream.str(), minRect);
-        maxLabelTexture = createTextTexture(maxStream.str(), maxRect);
-
-        // Position Labels
-        // Max label (Top Left)
-        maxRect.x = (int)(position.x - maxRect.w - 5);
-        maxRect.y = (int)(position.y);
-
-        // Min label (Bottom Left)
-        minRect.x = (int)(position.x - minRect.w - 5);
-        minRect.y = (int)(position.y + graphHeight - minRect.h);
-    }
-    
-    void appendValue(float value) {
-        values.push_back(value);
-        
-        bool limitsChanged = false;
-        // Update min and max
-        if (value < minValue) {
-            minValue = value;
-            limitsChanged = true;
-        }
-        if (value > maxValue) {
-            maxValue = value;
-            limitsChanged = true;
-        }
-
-        // Only regenerate text textures if the numbers actually changed
-        // This is much faster than doing it every frame
-        if (limitsChanged) {
-            updateLabels();
-        }
-    }
-    
-    void drawGraph() {
-        if (!renderer) return;
-
-        // 1. Draw Data Points (Red Lines)
-        SDL_SetRenderDrawColor(renderer, 220, 50, 50, 255);
-
-        float range = maxValue - minValue;
-        if (range == 0) range = 1.0f; // Prevent divide by zero
-
-        float xSpacing = graphWidth / (values.size() > 1 ? values.size() : 1);
-
-        for (size_t i = 1; i < values.size(); i++) {
-            float y1 = graphHeight - padding - (graphHeight - padding * 2) * (values[i - 1] - minValue) / range;
-            float y2 = graphHeight - padding - (graphHeight - padding * 2) * (values[i] - minValue) / range;
-
-            Vec2 start = position + Vec2(xSpacing * (i - 1), y1);
-            Vec2 end = position + Vec2(xSpacing * i, y2);
-            
-            SDL_RenderDrawLine(renderer, (int)start.x, (int)start.y, (int)end.x, (int)end.y);
-        }
-
-        // 2. Draw Axes (Black)
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-        
-        // Y Axis
-        SDL_RenderDrawLine(renderer, (int)position.x, (int)position.y, (int)position.x, (int)(position.y + graphHeight));
-        // X Axis
-        SDL_RenderDrawLine(renderer, (int)position.x, (int)(position.y + graphHeight), (int)(position.x + graphWidth), (int)(position.y + graphHeight));
-
-        // 3. Render Text Labels
-        if (titleTexture) SDL_RenderCopy(renderer, titleTexture, NULL, &titleRect);
-        if (maxLabelTexture) SDL_RenderCopy(renderer, maxLabelTexture, NULL, &maxRect);
-        if (minLabelTexture) SDL_RenderCopy(renderer, minLabelTexture, NULL, &minRect);
-    }
-    
-    void resetValues() {
-        values.clear();
-        maxValue = -10000000.0f; 
-        minValue = 10000000.0f;
-        updateLabels(); // Reset labels to 0
-    }
-
-    float getValue(int index) {
-        if(index >= 0 && index < values.size())
-            return values[index];
-        return 0.0f;
-    }
-};
+	using namespace std;
 	
 	// Gravity in pixels per second squared
 	const float gravity = 9.81f; // 1 metre will be 10 pixels?
@@ -267,294 +65,539 @@ public:
 		}
 	}
 	
-	float getSensorValueAtPoint(const float &displacement) {
-		return 100/(displacement + 100); // prop to 1/r
-	}
 	
-	class PIDController {
-		public:
-		float p, i, d;
-		float integral, lastError;
-		
-		PIDController(float p, float i, float d) {
-			this->p = p;
-			this->i = i;
-			this->d = d;
-			integral = 0;
-			lastError = 0;
-		}
-		
-		float update(float error, float dT) {
-			integral += error * dT;
-			float derivative = (error - lastError) / dT;
-			lastError = error;
-			return p*error + i*integral + d*derivative;
-		}
+	// Command line options, mostly for headless capture
+	struct HeadlessOptions {
+		int frames = 600;
+		int fps = 60;
+		string out = "capture.y4m";
+		FrameWriter::Format format = FrameWriter::Y4M;
+		string scenario = "hold"; // target trajectory, see makeScenario()
+		string loadStatePath; // start from a saved state instead of the initial one
+		string saveStatePath; // save the final state, e.g. after a warm-up run
+		string telemetryPath; // record every step for PID-Controller-analyze
+		string integrator = "discrete"; // see makeIntegrator()
+		string noise = "none"; // sensor noise, see makeSensorNoise()
+		StageRates rates; // separate sensor/control/physics rates, single rate by default
+		int agents = 0; // extra agents chasing the same target, drawn along with the simulated one
+		Camera camera; // view of the world, the whole window by default
 	};
 	
-	float addNoiseToSensorValue(float value) {
-		return value + (rand() % 100 - 50) / 10000.0f; // 0.5% noise
-	}
-	
-	
 	// Forward declerations
 	bool init();
+	bool initHeadless();
+	int runHeadless(const HeadlessOptions &options);
+	int streamHeadless(const HeadlessOptions &options, SDL_Surface* frame);
 	void kill();
-	void renderText(string text, SDL_Rect dest);
+	void renderText(HudLabel &label, SDL_Rect dest);
+	template<typename T>
+	void renderText(HudLabel &label, const char* prefix, T value, SDL_Rect dest);
+	void renderScene(const SimSnapshot &snap);
+	void drawBackground(SDL_Renderer* target);
+	TTF_Font* openFont();
 	
 	SDL_Window* window;
 	SDL_Renderer* renderer;
-	SDL_Texture* box;
 	TTF_Font* font;
-	SDL_Texture* heatmapTexture;
+	
+	// The light's heatmap, sharper the further in the camera zooms
+	HeatmapPyramid heatmap;
+	
+	// Every agent on screen goes through this, in one draw call
+	AgentRenderer agentRenderer;
+	// How many agents C brings in when --agents wasn't given
+	const int DEFAULT_CROWD = 1000;
+	
+	// What part of the world is on screen. Everything in the scene is drawn
+	// through it, apart from the HUD
+	Camera camera;
+	
+	// Grid and fixed labels, drawn once and blitted every frame (and again
+	// whenever the visible world rect changes)
+	StaticLayer backgroundLayer(drawBackground);
+	HudLabel clickHint;
+	
+	// Shortest frame time while the scene changes
+	const int FRAME_MS = 15;
+	// How long to wait for events once nothing visible is changing
+	const int IDLE_WAIT_MS = 100;
+	// An idle scene still redraws this often, to keep the HUD current
+	const Uint32 IDLE_REFRESH_MS = 1000;
+	
+	// Whether b would look different from a on screen. Sub-pixel motion and
+	// the last decimals of the HUD don't count, so a settled agent goes idle
+	bool drawsDifferently(const SimSnapshot &a, const SimSnapshot &b) {
+		const float PIXEL = 0.25f;
+		auto moved = [&](const Vec2 &from, const Vec2 &to) {
+			return (to - from).magnitude_squared() > PIXEL * PIXEL;
+		};
+		return moved(a.target, b.target) || moved(a.pos, b.pos) || a.crowdPos.size() != b.crowdPos.size()
+			|| moved(a.vel * agentRenderer.velocityScale, b.vel * agentRenderer.velocityScale)
+			|| a.gains.p != b.gains.p || a.gains.i != b.gains.i || a.gains.d != b.gains.d;
+	}
+	
+	// One label per HUD line, in the order renderScene draws them
+	const int HUD_LINES = 17;
+	HudLabel hudLabels[HUD_LINES];
+	
+	// Heap allocations during the last frame, over all threads (ALLOC_PROFILE builds)
+	uint64_t frameAllocations = 0, frameBytes = 0;
+	
+	// Works out frameAllocations and frameBytes from the running totals
+	void countFrameAllocations() {
+		static uint64_t lastAllocations = 0, lastBytes = 0;
+		uint64_t allocations, bytes;
+		alloccount::totals(allocations, bytes);
+		frameAllocations = allocations - lastAllocations;
+		frameBytes = bytes - lastBytes;
+		lastAllocations = allocations;
+		lastBytes = bytes;
+	}
 	
 	int main(int argc, char** args) {
 		
+		bool headless = false;
+		HeadlessOptions options;
+		for (int i = 1; i < argc; i++) {
+			if (strcmp(args[i], "--headless") == 0) {
+				headless = true;
+			} else if (strcmp(args[i], "--frames") == 0 && i + 1 < argc) {
+				options.frames = atoi(args[++i]);
+				if (options.frames < 0) {
+					cerr << "--frames expects a count of 0 or more" << endl;
+					return 1;
+				}
+			} else if (strcmp(args[i], "--fps") == 0 && i + 1 < argc) {
+				options.fps = atoi(args[++i]);
+				if (options.fps <= 0) {
+					cerr << "--fps expects a rate above 0" << endl;
+					return 1;
+				}
+			} else if (strcmp(args[i], "--out") == 0 && i + 1 < argc) {
+				options.out = args[++i];
+			} else if (strcmp(args[i], "--raw") == 0) {
+				options.format = FrameWriter::RAW_RGBA;
+			} else if (strcmp(args[i], "--load-state") == 0 && i + 1 < argc) {
+				options.loadStatePath = args[++i];
+			} else if (strcmp(args[i], "--save-state") == 0 && i + 1 < argc) {
+				options.saveStatePath = args[++i];
+			} else if (strcmp(args[i], "--integrator") == 0 && i + 1 < argc) {
+				options.integrator = args[++i];
+			} else if (strcmp(args[i], "--rates") == 0 && i + 1 < argc) {
+				// sensor, control and physics rates in Hz
+				float sensorHz = 0, controlHz = 0, physicsHz = 0;
+				if (sscanf(args[++i], "%f,%f,%f", &sensorHz, &controlHz, &physicsHz) != 3 || sensorHz <= 0 || controlHz <= 0 || physicsHz <= 0) {
+					cerr << "--rates expects SENSOR_HZ,CONTROL_HZ,PHYSICS_HZ" << endl;
+					return 1;
+				}
+				options.rates.sensorPeriod = 1 / sensorHz;
+				options.rates.controlPeriod = 1 / controlHz;
+				options.rates.physicsPeriod = 1 / physicsHz;
+			} else if (strcmp(args[i], "--sensor-delay") == 0 && i + 1 < argc) {
+				options.rates.sensorDelay = atoi(args[++i]);
+			} else if (strcmp(args[i], "--agents") == 0 && i + 1 < argc) {
+				options.agents = max(0, atoi(args[++i]));
+			} else if (strcmp(args[i], "--camera") == 0 && i + 1 < argc) {
+				// world point in the middle of the frame, and zoom
+				float x = 0, y = 0, zoom = 0;
+				if (sscanf(args[++i], "%f,%f,%f", &x, &y, &zoom) != 3 || zoom < Camera::MIN_ZOOM || zoom > Camera::MAX_ZOOM) {
+					cerr << "--camera expects X,Y,ZOOM with ZOOM from " << Camera::MIN_ZOOM << " to " << Camera::MAX_ZOOM << endl;
+					return 1;
+				}
+				options.camera.centre = Vec2(x, y);
+				options.camera.zoom = zoom;
+			} else if (strcmp(args[i], "--noise") == 0 && i + 1 < argc) {
+				options.noise = args[++i];
+			} else if (strcmp(args[i], "--telemetry") == 0 && i + 1 < argc) {
+				options.telemetryPath = args[++i];
+			} else if (strcmp(args[i], "--scenario") == 0 && i + 1 < argc) {
+				options.scenario = args[++i];
+			} else if (strcmp(args[i], "--target") == 0 && i + 2 < argc) {
+				options.scenario = string("hold:") + args[i + 1] + "," + args[i + 2];
+				i += 2;
+			} else {
+				cerr << "Unknown argument: " << args[i] << endl;
+				cerr << "Usage: " << args[0] << " [--agents N] [--headless [--frames N] [--fps N] [--out FILE|-] [--raw] [--scenario NAME | --target X Y] [--load-state FILE] [--save-state FILE] [--telemetry FILE] [--integrator NAME] [--noise NAME] [--rates SENSOR_HZ,CONTROL_HZ,PHYSICS_HZ] [--sensor-delay SAMPLES] [--camera X,Y,ZOOM]]" << endl;
+				cerr << "Integrators: " << integratorNames() << endl;
+				cerr << "Sensor noise: " << noiseNames() << endl;
+				cerr << "Scenarios: " << scenarioNames() << endl;
+				return 1;
+			}
+		}
+		if (headless) {
+			return runHeadless(options);
+		}
+		
 		if ( !init() ) {
 			system("pause");
 			return 1;
 		}
 		
+		alloccount::nameThread("main");
 		srand(time(NULL));
 		bool running = true;
-		Uint32 lastUpdate = 0;
-		PIDController xPID = PIDController(0.25, 0.1, 0.1);
-		PIDController yPID = PIDController(0.25, 0.1, 0.1);
 		int mouseX; int mouseY;
-		Vec2 sensorArrayPos = Vec2(1080, 720)/2;
-		Vec2 sensorArrayVel;
-		int sensorOffset = 20;
-		float errorX, errorY;
-		SDL_Color diff;
-		const int NUM_COLORS = 5;
-		const SDL_Color color[NUM_COLORS] = {
-			{0, 0, 0}, // black
-			{0, 0, 255}, // blue
-			{0, 255, 255}, // cyan
-			{0, 255, 0}, // green
-			{255, 0, 0} // red
-		};
-		
-		
-		float valueDiff;
-		float displacement;
-		float value;
-
-		float sensorValues[4] = {0};
+		PIDGains gains;
 		
-		// init heatmap
-		// A static array of 4 colors:  (black, blue, cyan, green, red)
-		float colorBounds[NUM_COLORS] = {0.1, 0.2, 0.4, 0.55, 0.85};
-		SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, 1080/4, 1080/4, 32, SDL_PIXELFORMAT_RGBA8888);
-		SDL_LockSurface(surface);
-		Uint32* pixels = (Uint32*)surface->pixels;
-		for (int y = 0; y < 1080/4; y+=5) {
-			for (int x = 0; x < 1080/4; x+=5) {
-				displacement = sqrt((1080/4/2-x)*(1080/4/2-x) + (1080/4/2-y)*(1080/4/2-y));
-				displacement *= 4;
-				if (displacement < 500) {
-					value = getSensorValueAtPoint(displacement);
-					// get colour							
-						// Find the correct color bounds
-						int k = 0;
-						while (k < NUM_COLORS - 1 && value > colorBounds[k+1]) {
-							k++;
-						}
-				
-						// Calculate the correct color
-						valueDiff = (value - colorBounds[k]) / (colorBounds[k+1] - colorBounds[k]);
-						Uint8 r = (Uint8)((color[k+1].r - color[k].r) * valueDiff + color[k].r);
-						Uint8 g = (Uint8)((color[k+1].g - color[k].g) * valueDiff + color[k].g);
-						Uint8 b = (Uint8)((color[k+1].b - color[k].b) * valueDiff + color[k].b);
-						// Calculate Alpha based on X position (0 = fully transparent, 255 = fully opaque)
-						// Uint8 a = (Uint8)((float)x / 1080 * 255);
-						Uint8 a = (Uint8)(170 - 0.2f*displacement); // more displacement = more transparent
-						// cap alpha
-						if (a > 255) a = 255;
-						
-						// Map the RGBA values to the specific format of the surface
-						pixels[y * 1080/4 + x] = SDL_MapRGBA(surface->format, r, g, b, a);
-					}
-			}
-		}
-		SDL_UnlockSurface(surface);
-		SDL_Texture* heatmapTexture = SDL_CreateTextureFromSurface(renderer, surface);
-		SDL_FreeSurface(surface);
-		SDL_SetTextureBlendMode(heatmapTexture, SDL_BLENDMODE_BLEND);
+		// The simulation steps on its own thread; this loop only handles input and draws
+		SimulationThread simThread;
+		simThread.start();
 		
+		// Only redraw when something visible changed (see drawsDifferently)
+		bool sceneDirty = true;
+		bool idle = false;
+		SimSnapshot drawn;
+		Uint32 lastDraw = 0;
 		
+		// Extra agents for multi-agent scenes (--agents, or C in the window).
+		// They step on the simulation thread and arrive in its snapshots
+		int crowdAgents = max(options.agents, 0);
 		
 		while(running) {
+			AllocScope frameScope("frame");
 			SDL_Event e;
-			SDL_SetRenderDrawColor( renderer, 50, 50, 50, 255 );
-			SDL_RenderClear( renderer );
 			
-			// Event loop
-			while ( SDL_PollEvent( &e ) != 0 ) {
+			// Event loop. Sleeps until input arrives or the next frame is due
+			// (the next check, once idle), so an idle window costs next to nothing
+			Uint32 sinceDraw = SDL_GetTicks() - lastDraw;
+			int wait = idle ? IDLE_WAIT_MS : sinceDraw < (Uint32)FRAME_MS ? FRAME_MS - (int)sinceDraw : 0;
+			bool gotEvent = (wait > 0 ? SDL_WaitEventTimeout( &e, wait ) : SDL_PollEvent( &e )) != 0;
+			for (; gotEvent; gotEvent = SDL_PollEvent( &e ) != 0) {
+				sceneDirty = true;
 				switch (e.type) {
 					case SDL_QUIT:
 					running = false;
 					break;
 				}
-				switch(e.key.keysym.sym) {
-					case SDLK_RIGHT: 
-					cout << "Right was pressed" << endl;
-					break;
-					case SDLK_LEFT:
-					cout << "Left was pressed" << endl;
-					break;
-					// case SDLK_UP:
-					//     cout << "Up was pressed" << endl;
-					//     break;
-					// case SDLK_DOWN:
-					//     cout << "Down was pressed" << endl;
-					//     break;	
+				
+				// camera: wheel zooms about the mouse, right or middle drag pans,
+				// + and - zoom about the middle and 0 or h go back to the whole window
+				if (e.type == SDL_MOUSEWHEEL) {
+					SDL_GetMouseState(&mouseX, &mouseY);
+					camera.zoomAt(Vec2(mouseX, mouseY), powf(1.1f, (float)e.wheel.y));
+				} else if (e.type == SDL_MOUSEMOTION && (e.motion.state & (SDL_BUTTON_RMASK | SDL_BUTTON_MMASK))) {
+					camera.pan(Vec2(e.motion.xrel, e.motion.yrel));
+				} else if (e.type == SDL_KEYDOWN) {
+					Vec2 middle(camera.width * 0.5f, camera.height * 0.5f);
+					switch (e.key.keysym.sym) {
+						case SDLK_EQUALS:
+						case SDLK_PLUS:
+						case SDLK_KP_PLUS:
+						camera.zoomAt(middle, 1.25f);
+						break;
+						case SDLK_MINUS:
+						case SDLK_KP_MINUS:
+						camera.zoomAt(middle, 0.8f);
+						break;
+						case SDLK_0:
+						case SDLK_h:
+						camera = Camera();
+						break;
+						case SDLK_c:
+						// bring the crowd in, or send it away
+						crowdAgents = crowdAgents ? 0 : options.agents > 0 ? options.agents : DEFAULT_CROWD;
+						break;
+					}
 				}
 				
 				// detect input for PID constants
-				if (e.type == SDL_MOUSEBUTTONDOWN) {
-					cout << "Mouse button was pressed" << endl;
-					cout << "Mouse X: " << e.button.x << " Mouse Y: " << e.button.y << endl;
+				if (e.type == SDL_MOUSEBUTTONDOWN && e.button.button == SDL_BUTTON_LEFT) {
 					if (e.button.x > 681) {
 						
 						if (e.button.y < 40+30) {
-							xPID.p -= 0.01, yPID.p -= 0.01;
+							gains.p -= 0.01;
 						} else if (e.button.y < 70+30) {
-							xPID.i -= 0.01, yPID.i -= 0.01;
+							gains.i -= 0.01;
 						} else if (e.button.y < 100+30) {
-							xPID.d -= 0.01, yPID.d -= 0.01;
+							gains.d -= 0.01;
 						}
 						
 					} else if (e.button.x > 660) {
 						
 						if (e.button.y < 40+30) {
-							xPID.p += 0.01, yPID.p += 0.01;
+							gains.p += 0.01;
 						} else if (e.button.y < 70+30) {
-							xPID.i += 0.01, yPID.i += 0.01;
+							gains.i += 0.01;
 						} else if (e.button.y < 100+30) {
-							xPID.d += 0.01, yPID.d += 0.01;
+							gains.d += 0.01;
 						}
 						
 					}
 				}
 			}
 			
-			// Physics loop
-			Uint32 time = SDL_GetTicks();
-			float dT = (time - lastUpdate) / 1000.0f;
-			cout << "fps: " << 1/(dT) << endl;
-			lastUpdate = time;
-			SDL_Delay(15);
-			
+			// Hand the latest input to the simulation thread
 			SDL_GetMouseState(&mouseX, &mouseY);
+			SimInputs &in = simThread.inputs.writeSlot();
+			in.target = camera.toWorld(Vec2(mouseX, mouseY));
+			in.gains = gains;
+			in.crowdAgents = crowdAgents;
+			simThread.inputs.publish();
 			
-			// calculate scale
-			float avgSensorValue = (sensorValues[0] + sensorValues[1] + sensorValues[2] + sensorValues[3])/4;
-			// cout << "avg sensor val: " << avgSensorValue << endl;
-			float scale = avgSensorValue == 0 ? 1 :  0.01/(avgSensorValue) + 0.08;
-			// constrain scale
-			cout << "scale before constraining: " << scale << endl;
-			scale = scale > 10e3  ? 10e3  : scale;
-			scale = scale < 1 ? 1 : scale;
-
-			sensorArrayVel.x += scale * xPID.update(errorX, dT);
-			sensorArrayVel.y += scale * yPID.update(errorY, dT);
+			// Draw the newest state the simulation has published, if it looks
+			// any different. The HUD still refreshes now and then
+			simThread.snapshots.update();
+			const SimSnapshot &snap = simThread.snapshots.read();
+			sceneDirty = sceneDirty || snap.crowdAwake > 0;
+			Uint32 time = SDL_GetTicks();
+			sceneDirty = sceneDirty || drawsDifferently(drawn, snap) || time - lastDraw >= IDLE_REFRESH_MS;
+			idle = !sceneDirty;
+			// Cap the frame rate while things move: input events wake the loop as
+			// fast as they arrive, and the next pass waits out the rest of the frame
+			if (idle || time - lastDraw < (Uint32)FRAME_MS) continue;
 			
-			sensorArrayPos.x += sensorArrayVel.x * dT;
-			sensorArrayPos.y += sensorArrayVel.y * dT;
+			renderScene(snap);
+			drawn = snap;
+			lastDraw = time;
+			// heatmap tiles still to generate need another frame
+			sceneDirty = heatmap.refining();
 			
-			{ // get sensor values and errors
-				sensorValues[4];
-				int index = 0;
-				for (int i=-1; i<=1; i+=2) {
-					// goes from top, clockwise
-					sensorValues[index] = getSensorValueAtPoint(
-						(mouseX-sensorArrayPos.x)*(mouseX-sensorArrayPos.x)
-						+ (mouseY - (sensorArrayPos.y + i*sensorOffset))*(mouseY - (sensorArrayPos.y + i*sensorOffset)));
-						index++;
-						sensorValues[i+2] = getSensorValueAtPoint(
-							(mouseX - (sensorArrayPos.x - i*sensorOffset))*(mouseX - (sensorArrayPos.x - i*sensorOffset))
-							+ (mouseY - sensorArrayPos.y)*(mouseY - sensorArrayPos.y));
-							index++;
-						}
-						errorY = 200*(sensorValues[2] - sensorValues[0]);
-						// errorY = 200*addNoiseToSensorValue(sensorValues[2] - sensorValues[0]);
-						errorX = -200*(sensorValues[3] - sensorValues[1]);
-						// errorX = -200*addNoiseToSensorValue(sensorValues[3] - sensorValues[1]);
-					}
-					
-					// Render loop
-						// render heat map
-							SDL_Rect destRect = { mouseX - (1080/2), mouseY - (1080/2), 1080, 1080};
-							SDL_RenderCopy(renderer, heatmapTexture, NULL, &destRect);
-						// render grid background
-							SDL_SetRenderDrawColor(renderer, 110, 110, 110, 255);
-							for (int i=0; i<1080; i+=100) {
-								SDL_RenderDrawLine(renderer, i, 0, i, 720);
-						}
-							for (int i=0; i<720; i+=100) {
-								SDL_RenderDrawLine(renderer, 0, i, 1080, i);
-						}
-							SDL_SetRenderDrawColor(renderer, 240, 240, 240, 255);
-						// render sensor array
-							for (int i=-1; i<=1; i+=2) {
-								DrawCircle(renderer, sensorArrayPos.x + i*sensorOffset, sensorArrayPos.y, 7);
-								DrawCircle(renderer, sensorArrayPos.x, sensorArrayPos.y + i*sensorOffset, 7);
-							}
-						// render label in top left
-							renderText("Mouse X: " + to_string(mouseX), {10, 10});
-							renderText("Mouse Y: " + to_string(mouseY), {10, 40});
-							renderText("Sensor X: " + to_string(sensorArrayPos.x), {10, 70});
-							renderText("Sensor Y: " + to_string(sensorArrayPos.y), {10, 100});
-							renderText("Velocity X: " + to_string(sensorArrayVel.x), {10, 130});
-							renderText("Velocity Y: " + to_string(sensorArrayVel.y), {10, 160});
-							renderText("Error X: " + to_string(errorX), {10, 190});
-							renderText("Error Y: " + to_string(errorY), {10, 220});
-							renderText("Integral X: " + to_string(xPID.integral), {10, 250});
-							renderText("Integral Y: " + to_string(yPID.integral), {10, 280});
-							renderText("Derivative X: " + to_string((errorX - xPID.lastError) / dT), {10, 310});
-							renderText("Derivative Y: " + to_string((errorY - yPID.lastError) / dT), {10, 340});
-							
-							renderText("(Click to change these)", {1080-350, 10});
-							renderText("^ \\/ k_proportional: " + to_string(xPID.p), {1080-420, 40});
-							renderText("^ \\/ k_integral: " + to_string(xPID.i), {1080-420, 70});
-							renderText("^ \\/ k_derivative: " + to_string(xPID.d), {1080-420, 100});
-							
-							
-						// Display window + delay
-							// SDL_Delay(15);		
-							SDL_RenderPresent(renderer);
-					}
-				
-				kill();
-				return 0;
+			// Display window
+			SDL_RenderPresent(renderer);
+			countFrameAllocations();
+		}
+		
+		simThread.stop();
+		kill();
+		if (alloccount::enabled) alloccount::printSummary(cout);
+		return 0;
+	}
+	
+	// Renders the scene into an offscreen software surface and streams every
+	// frame to options.out. Needs no display or GPU: uses SDL's dummy video driver.
+	// Logs go to stderr so "--out -" can be piped straight into an encoder
+	int runHeadless(const HeadlessOptions &options) {
+		SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
+		#ifdef SIGPIPE
+		// a reader of "--out -" that exits should fail the next write, which
+		// FrameWriter reports, rather than kill the process on the spot
+		signal(SIGPIPE, SIG_IGN);
+		#endif
+		int result = 1;
+		SDL_Surface* frame = NULL;
+		if ( initHeadless() ) {
+			frame = SDL_CreateRGBSurfaceWithFormat(0, 1080, 720, 32, SDL_PIXELFORMAT_RGBA32);
+			renderer = frame ? SDL_CreateSoftwareRenderer(frame) : NULL;
+			if ( renderer ) {
+				result = streamHeadless(options, frame);
+			} else {
+				cerr << "Error creating software renderer: " << SDL_GetError() << endl;
+			}
+		}
+		// every way out goes through here, so nothing is left to the OS
+		kill();
+		SDL_FreeSurface(frame);
+		if (alloccount::enabled) alloccount::printSummary(cerr);
+		return result;
+	}
+	
+	// runHeadless() once SDL and the renderer are up. Returns the exit code
+	int streamHeadless(const HeadlessOptions &options, SDL_Surface* frame) {
+		camera = options.camera;
+		heatmap.tileBudget = 0; // every frame fully refined
+		
+		unique_ptr<Scenario> scenario = makeScenario(options.scenario);
+		if ( !scenario ) {
+			cerr << "Unknown scenario " << options.scenario << ", expected one of: " << scenarioNames() << endl;
+			return 1;
+		}
+		
+		FrameWriter writer(1080, 720, options.fps, options.format);
+		if ( !writer.open(options.out) ) {
+			cerr << "Error opening " << options.out << ": " << strerror(errno) << endl;
+			return 1;
+		}
+		
+		TelemetryWriter telemetry;
+		if ( !options.telemetryPath.empty() && !telemetry.open(options.telemetryPath) ) {
+			cerr << "Error opening " << options.telemetryPath << ": " << strerror(errno) << endl;
+			return 1;
+		}
+		
+		// The simulation keeps its own fixed rate; frames sample it at options.fps
+		Simulation sim;
+		sim.setGains(PIDGains());
+		if ( !makeIntegrator(options.integrator, sim.integrator) ) {
+			cerr << "Unknown integrator " << options.integrator << ", expected one of: " << integratorNames() << endl;
+			return 1;
+		}
+		if ( !makeSensorNoise(options.noise, sim.noise) ) {
+			cerr << "Unknown sensor noise " << options.noise << ", expected one of: " << noiseNames() << endl;
+			return 1;
+		}
+		if ( options.rates.multiRate() ) {
+			sim.setRates(options.rates);
+		}
+		if ( !options.loadStatePath.empty() ) {
+			vector<uint8_t> state;
+			if ( !readStateFile(options.loadStatePath, state) || !loadState(sim, state) ) {
+				cerr << "Error loading state from " << options.loadStatePath << endl;
+				return 1;
+			}
+		}
+		unique_ptr<AgentBatch> crowd;
+		if ( options.agents > 0 ) {
+			crowd = makeCrowd(options.agents);
+			crowd->noise.kind = sim.noise.kind;
+		}
+		// Frame f shows the simulation as close to f / fps seconds in as whole
+		// steps allow, so frame rates that don't divide the sim rate don't drift
+		const double stepsPerFrame = 1.0 / (options.fps * (double)SIM_DT);
+		long long steps = 0;
+		SimSnapshot snap;
+		for (int f = 0; f < options.frames && !writer.failed(); f++) {
+			for (; steps < llround((f + 1) * stepsPerFrame); steps++) {
+				sim.step(scenario->next(SIM_DT), SIM_DT);
+				if ( crowd ) {
+					crowd->setTarget(sim.target);
+					crowd->step(SIM_DT);
+				}
+				if ( !options.telemetryPath.empty() ) {
+					telemetry.write({sim.time, sim.target.x, sim.target.y,
+						(float)sim.agent.pos.x, (float)sim.agent.pos.y,
+						(float)sim.agent.xPID.lastError, (float)sim.agent.yPID.lastError,
+						sim.lastControl.x, sim.lastControl.y});
+				}
+			}
+			sim.writeSnapshot(snap);
+			writeCrowdSnapshot(crowd.get(), snap);
+			renderScene(snap);
+			SDL_RenderPresent(renderer);
+			countFrameAllocations();
+			
+			SDL_LockSurface(frame);
+			writer.submit((const Uint8*)frame->pixels, frame->pitch);
+			SDL_UnlockSurface(frame);
+		}
+		
+		writer.close();
+		telemetry.close();
+		if ( writer.failed() ) {
+			cerr << "Error writing " << options.out << " after " << writer.framesWritten() << " frames: " << strerror(writer.error()) << endl;
+			return 1;
+		}
+		if ( telemetry.failed() ) {
+			cerr << "Error writing " << options.telemetryPath << ": " << strerror(telemetry.error()) << endl;
+			return 1;
+		}
+		cerr << "Wrote " << writer.framesWritten() << " frames to " << options.out << endl;
+		const RunMetrics &m = sim.metrics;
+		cerr << "ISE " << m.ise << "  IAE " << m.iae << "  ITAE " << m.itae << "  effort " << m.effort
+			<< "  overshoot " << m.overshoot * 100 << "%  rise " << m.riseTime << "s  settling " << m.settlingTime << "s" << endl;
+		if ( !options.saveStatePath.empty() ) {
+			vector<uint8_t> state;
+			saveState(sim, state);
+			if ( !writeStateFile(options.saveStatePath, state) ) {
+				cerr << "Error saving state to " << options.saveStatePath << endl;
+				return 1;
 			}
+		}
+		return 0;
+	}
+	
+	// Draws one simulation state: heatmap, grid, sensor array and HUD
+	void renderScene(const SimSnapshot &snap) {
+		AllocScope scope("render");
+		int mouseX = (int)snap.target.x;
+		int mouseY = (int)snap.target.y;
+		float sensorOffset = snap.sensorOffset;
+		Vec2 sensorArrayPos = snap.pos;
+		float dT = snap.dT;
+		
+		SDL_SetRenderDrawColor( renderer, 50, 50, 50, 255 );
+		SDL_RenderClear( renderer );
+		
+		// render heat map: only its tiles on screen, at a level to suit the zoom
+			heatmap.render(renderer, camera, snap.target);
+		// render grid background and the labels that never change
+			static Vec2 layerTopLeft, layerBottomRight;
+			Vec2 topLeft, bottomRight;
+			camera.worldBounds(topLeft, bottomRight);
+			if (topLeft.x != layerTopLeft.x || topLeft.y != layerTopLeft.y
+				|| bottomRight.x != layerBottomRight.x || bottomRight.y != layerBottomRight.y) {
+				backgroundLayer.invalidate();
+				layerTopLeft = topLeft;
+				layerBottomRight = bottomRight;
+			}
+			backgroundLayer.render(renderer);
+		// render sensor arrays: the simulated one plus any crowd, in one draw
+		// call. Off screen agents are skipped, and far out they become points
+			agentRenderer.reserve(snap.crowdPos.size() + 1);
+			agentRenderer.begin(camera);
+			agentRenderer.add(sensorArrayPos, snap.vel, sensorOffset);
+			for (size_t a = 0; a < snap.crowdPos.size(); a++) {
+				agentRenderer.add(snap.crowdPos[a], snap.crowdVel[a], snap.crowdSensorOffset[a]);
+			}
+			agentRenderer.draw(renderer);
+		// render label in top left. Labels only re-render when their text changes
+			NoAllocations noAllocations;
+			int line = 0;
+			renderText(hudLabels[line++], "Mouse X: ", mouseX, {10, 10});
+			renderText(hudLabels[line++], "Mouse Y: ", mouseY, {10, 40});
+			renderText(hudLabels[line++], "Sensor X: ", sensorArrayPos.x, {10, 70});
+			renderText(hudLabels[line++], "Sensor Y: ", sensorArrayPos.y, {10, 100});
+			renderText(hudLabels[line++], "Velocity X: ", snap.vel.x, {10, 130});
+			renderText(hudLabels[line++], "Velocity Y: ", snap.vel.y, {10, 160});
+			renderText(hudLabels[line++], "Error X: ", snap.errorX, {10, 190});
+			renderText(hudLabels[line++], "Error Y: ", snap.errorY, {10, 220});
+			renderText(hudLabels[line++], "Integral X: ", snap.integralX, {10, 250});
+			renderText(hudLabels[line++], "Integral Y: ", snap.integralY, {10, 280});
+			renderText(hudLabels[line++], "Derivative X: ", (snap.errorX - snap.lastErrorX) / dT, {10, 310});
+			renderText(hudLabels[line++], "Derivative Y: ", (snap.errorY - snap.lastErrorY) / dT, {10, 340});
+			
+			renderText(hudLabels[line++], "^ \\/ k_proportional: ", snap.gains.p, {1080-420, 40});
+			renderText(hudLabels[line++], "^ \\/ k_integral: ", snap.gains.i, {1080-420, 70});
+			renderText(hudLabels[line++], "^ \\/ k_derivative: ", snap.gains.d, {1080-420, 100});
 			
-			void renderText(string text, SDL_Rect dest) {
+			if (alloccount::enabled) {
+				renderText(hudLabels[line++], "Allocations last frame: ", frameAllocations, {10, 370});
+				renderText(hudLabels[line++], "Bytes last frame: ", frameBytes, {10, 400});
+			}
+	}
+	
+	// Everything in backgroundLayer
+	void drawBackground(SDL_Renderer* target) {
+		// grid every 100 world px, or every 1000, 10000... when zoomed out far
+		// enough that lines would be closer than 20 px
+			SDL_SetRenderDrawColor(target, 110, 110, 110, 255);
+			float spacing = 100;
+			while (spacing * camera.zoom < 20) spacing *= 10;
+			Vec2 topLeft, bottomRight;
+			camera.worldBounds(topLeft, bottomRight);
+			for (float x = ceilf(topLeft.x / spacing) * spacing; x < bottomRight.x; x += spacing) {
+				int screenX = (int)lroundf(camera.toScreen(Vec2(x, 0)).x);
+				SDL_RenderDrawLine(target, screenX, 0, screenX, camera.height);
+		}
+			for (float y = ceilf(topLeft.y / spacing) * spacing; y < bottomRight.y; y += spacing) {
+				int screenY = (int)lroundf(camera.toScreen(Vec2(0, y)).y);
+				SDL_RenderDrawLine(target, 0, screenY, camera.width, screenY);
+		}
+		// fixed labels
+			clickHint.setText("(Click to change these)");
+			renderText(clickHint, {1080-350, 10});
+	}
+	
+	void renderText(HudLabel &label, SDL_Rect dest) {
+				AllocScope scope("renderText");
 				SDL_Color fg = { 175, 175, 175 };
-				SDL_Surface* surf = TTF_RenderText_Solid(font, text.c_str(), fg);
-				
-				dest.w = surf->w;
-				dest.h = surf->h;
-				
-				SDL_Texture* tex = SDL_CreateTextureFromSurface(renderer, surf);
-				
-				SDL_RenderCopy(renderer, tex, NULL, &dest);
-				SDL_DestroyTexture(tex);
-				SDL_FreeSurface(surf);
+				label.draw(renderer, font, fg, dest.x, dest.y);
+			}
+			
+			// Formats "prefix value" into label without allocating, then draws it
+			template<typename T>
+			void renderText(HudLabel &label, const char* prefix, T value, SDL_Rect dest) {
+				label.set(prefix, value);
+				renderText(label, dest);
 			}
 			
+			// Window, renderer and font. Video (which brings events with it) is the
+			// only subsystem used
 			bool init() {
-				if ( SDL_Init( SDL_INIT_EVERYTHING ) < 0 ) {
+				if ( SDL_Init( SDL_INIT_VIDEO ) < 0 ) {
 					cout << "Error initializing SDL: " << SDL_GetError() << endl;
 					return false;
 				} 
 				
-				if ( IMG_Init(IMG_INIT_JPG) < 0 ) {
-					cout << "Error initializing SDL_image: " << IMG_GetError() << endl;
-					return false;
-				}
-				
 				if ( TTF_Init() < 0 ) {
 					cout << "Error initializing SDL_ttf: " << TTF_GetError() << endl;
 					return false;
@@ -572,36 +615,51 @@ public:
 					return false;
 				}
 				
-				SDL_Surface* buffer = IMG_Load("../box.jpg");
-				if ( !buffer ) {
-					cout << "Error loading image box.jpg: " << SDL_GetError() << endl;
+				font = openFont();
+				if ( !font ) {
+					cout << "Error loading font: " << TTF_GetError() << endl;
 					return false;
 				}
 				
-				box = SDL_CreateTextureFromSurface( renderer, buffer );
-				SDL_FreeSurface( buffer );
-				buffer = NULL;
-				if ( !box ) {
-					cout << "Error creating heatmapTexture: " << SDL_GetError() << endl;
+				return true;
+			}
+			
+			// Only what offscreen rendering needs: no window
+			bool initHeadless() {
+				if ( SDL_Init( SDL_INIT_VIDEO ) < 0 ) {
+					cerr << "Error initializing SDL: " << SDL_GetError() << endl;
+					return false;
+				} 
+				
+				if ( TTF_Init() < 0 ) {
+					cerr << "Error initializing SDL_ttf: " << TTF_GetError() << endl;
 					return false;
 				}
 				
-				font = TTF_OpenFont("../font.ttf", 24);
+				font = openFont();
 				if ( !font ) {
-					cout << "Error loading font: " << TTF_GetError() << endl;
+					cerr << "Error loading font: " << TTF_GetError() << endl;
 					return false;
 				}
 				
 				return true;
 			}
 			
+			// The font is compiled in (see CMakeLists.txt), so nothing is read from
+			// disk and the working directory doesn't matter
+			TTF_Font* openFont() {
+				SDL_RWops* data = SDL_RWFromConstMem( embedded::font_ttf, sizeof(embedded::font_ttf) );
+				return data ? TTF_OpenFontRW( data, 1, 24 ) : NULL;
+			}
+			
 			void kill() {
+				for (HudLabel &label : hudLabels) label.release();
+				clickHint.release();
+				backgroundLayer.release();
 				TTF_CloseFont( font );
-				SDL_DestroyTexture( box );
 				font = NULL;
-				box = NULL;
 
-				SDL_DestroyTexture(heatmapTexture);
+				heatmap.release();
 				
 				SDL_DestroyRenderer( renderer );
 				SDL_DestroyWindow( window );
@@ -609,7 +667,6 @@ public:
 				renderer = NULL;
 				
 				TTF_Quit();
-				IMG_Quit();
 				SDL_Quit();
 			}
 			
@@ -618,7 +675,6 @@ public:
 			//SDL_RenderDrawLine(renderer, 0, 0, 640, 480);
 			//SDL_RenderDrawPoint(renderer, 320, 240); 
 			//SDL_RenderFillRect(renderer, &rect);
-			//SDL_RenderCopy(renderer, box, NULL, &rect);
 			// int x, y; SDL_GetMouseState(&x, &y);
 			
 
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cmath>
+
+#include "vec2.h"
+
+// Cost of a run, accumulated one step at a time in O(1) memory, so sweeps
+// can rank gain sets without keeping trajectories.
+// The error is the distance from the agent to the target. The integrals
+// cover the whole run since reset(), and ITAE weights by the time since the
+// first update after reset(). Step response figures (overshoot, rise and
+// settling time) are measured against the first target seen after reset(),
+// and restart whenever the target jumps by more than REBASE_JUMP in one
+// update (or on an explicit rebase()); the integrals carry on.
+struct RunMetrics {
+	// Settling band, as a fraction of the initial distance
+	static constexpr float SETTLE_BAND = 0.02f;
+	// Rise time runs from covering RISE_LOW of the step to covering RISE_HIGH
+	static constexpr float RISE_LOW = 0.1f;
+	static constexpr float RISE_HIGH = 0.9f;
+	// Steps shorter than this (px) have no meaningful step response
+	static constexpr float MIN_STEP = 1.0f;
+	// A target move larger than this (px) in one update is a new step
+	static constexpr float REBASE_JUMP = 10.0f;
+
+	double ise = 0;    // integral of error squared
+	double iae = 0;    // integral of |error|
+	double itae = 0;   // integral of time since the run started * |error|
+	double effort = 0; // integral of |control|^2
+	float peakError = 0;
+	float overshoot = 0;     // furthest past the target along the step, fraction of the initial distance
+	float riseTime = -1;     // s from first covering RISE_LOW to first covering RISE_HIGH, -1 if not yet
+	float settlingTime = -1; // s after which it stayed within SETTLE_BAND, -1 if currently outside
+
+	double runStart = -1; // time of the first update after reset()
+
+	// Step reference
+	bool started = false;
+	double startTime = 0;
+	Vec2 start;
+	Vec2 target;
+	Vec2 direction; // unit vector from start to target
+	float initialDistance = 0;
+	double riseStart = -1; // step time when RISE_LOW was first covered
+	double settledSince = -1;
+	Vec2 lastTarget;
+
+	void reset() {
+		*this = RunMetrics();
+	}
+
+	// Restarts the step response measurement from the current position
+	void rebase() {
+		started = false;
+		overshoot = 0;
+		riseTime = -1;
+		settlingTime = -1;
+		riseStart = -1;
+		settledSince = -1;
+	}
+
+	void update(double time, const Vec2 &newTarget, const Vec2 &pos, const Vec2 &control, float dT) {
+		if (started && (newTarget - lastTarget).magnitude_squared() > REBASE_JUMP * REBASE_JUMP) {
+			rebase();
+		}
+		lastTarget = newTarget;
+		if (runStart < 0) runStart = time;
+		if (!started) {
+			started = true;
+			startTime = time;
+			start = pos;
+			target = newTarget;
+			initialDistance = sqrtf((target - start).magnitude_squared());
+			direction = initialDistance > 0 ? (target - start) / initialDistance : Vec2(0, 0);
+		}
+		double t = time - startTime;
+
+		float error = sqrtf((newTarget - pos).magnitude_squared());
+		ise += (double)error * error * dT;
+		iae += (double)error * dT;
+		itae += (time - runStart) * error * dT;
+		effort += (double)control.magnitude_squared() * dT;
+		if (error > peakError) peakError = error;
+
+		if (initialDistance < MIN_STEP) return;
+		float progress = ((pos - start) * direction) / initialDistance;
+		if (progress - 1 > overshoot) overshoot = progress - 1;
+
+		float relative = sqrtf((target - pos).magnitude_squared()) / initialDistance;
+		if (riseStart < 0 && relative <= 1 - RISE_LOW) riseStart = t;
+		if (riseTime < 0 && relative <= 1 - RISE_HIGH) riseTime = (float)(t - riseStart);
+		if (relative <= SETTLE_BAND) {
+			if (settledSince < 0) settledSince = t;
+			settlingTime = (float)settledSince;
+		} else {
+			settledSince = -1;
+			settlingTime = -1;
+		}
+	}
+};
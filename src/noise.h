@@ -0,0 +1,295 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "rng.h"
+
+// Sensor noise for many channels (agents x sensors) at once.
+// fill() writes one sample per channel per step, for the whole buffer in one
+// call. Random bits come from 64 interleaved xoshiro128+ streams, whose
+// update is only adds, xors and shifts, so generation vectorises on baseline
+// SSE2. Gaussians use the Marsaglia-Tsang ziggurat: its fast path (~98.5% of
+// samples) is a table lookup and multiply, done for the whole buffer without
+// branches, and only the rejections take the slow path through exp/log.
+// Coloured noise filters that white noise per channel:
+//  PINK  - 1/f noise (Paul Kellet's three pole approximation)
+//  DRIFT - white noise plus a slowly wandering bias per channel (random walk)
+
+namespace noise {
+	// 256 layer ziggurat for the standard normal (Marsaglia & Tsang 2000)
+	struct Ziggurat {
+		static const int LAYERS = 256;
+		uint32_t k[LAYERS]; // |hz| below k[i] is inside layer i's rectangle
+		float w[LAYERS];    // hz to x
+		float f[LAYERS];    // density at the layer edges
+
+		Ziggurat() {
+			const double m = 2147483648.0;
+			double dn = 3.6541528853610088, tn = dn, vn = 0.00492867323399;
+			double q = vn / exp(-0.5 * dn * dn);
+			k[0] = (uint32_t)((dn / q) * m);
+			k[1] = 0;
+			w[0] = (float)(q / m);
+			w[LAYERS - 1] = (float)(dn / m);
+			f[0] = 1.0f;
+			f[LAYERS - 1] = (float)exp(-0.5 * dn * dn);
+			for (int i = LAYERS - 2; i >= 1; i--) {
+				dn = sqrt(-2.0 * log(vn / dn + exp(-0.5 * dn * dn)));
+				k[i + 1] = (uint32_t)((dn / tn) * m);
+				tn = dn;
+				f[i] = (float)exp(-0.5 * dn * dn);
+				w[i] = (float)(dn / m);
+			}
+		}
+	};
+
+	inline const Ziggurat& ziggurat() {
+		static const Ziggurat table;
+		return table;
+	}
+
+	// STREAMS xoshiro128+ generators stepped together, each step giving one
+	// word per stream. Streams are the inner loop, so the update vectorises.
+	// Words are handed out in order through a one step buffer, so the sequence
+	// doesn't depend on how many are asked for at a time
+	struct Streams {
+		static const int STREAMS = 64;
+		uint32_t s0[STREAMS], s1[STREAMS], s2[STREAMS], s3[STREAMS];
+		uint32_t buffer[STREAMS] = {};
+		uint32_t buffered = 0; // unread words at the end of buffer
+
+		void seed(uint64_t seed) {
+			Rng init(seed, 0x5eed);
+			for (int l = 0; l < STREAMS; l++) {
+				// never all zero
+				s0[l] = init.next() | 1;
+				s1[l] = init.next();
+				s2[l] = init.next();
+				s3[l] = init.next();
+			}
+			buffered = 0;
+		}
+
+		void next(uint32_t* out, size_t n) {
+			size_t done = 0;
+			while (done < n) {
+				if (buffered == 0) {
+					step();
+					buffered = STREAMS;
+				}
+				size_t take = n - done < buffered ? n - done : buffered;
+				memcpy(out + done, buffer + STREAMS - buffered, take * sizeof(uint32_t));
+				buffered -= take;
+				done += take;
+			}
+		}
+
+		private:
+		void step() {
+			for (int l = 0; l < STREAMS; l++) {
+				buffer[l] = s0[l] + s3[l];
+				uint32_t t = s1[l] << 9;
+				s2[l] ^= s0[l];
+				s3[l] ^= s1[l];
+				s1[l] ^= s2[l];
+				s0[l] ^= s3[l];
+				s2[l] ^= t;
+				s3[l] = (s3[l] << 11) | (s3[l] >> 21);
+			}
+		}
+	};
+}
+
+class SensorNoise {
+	public:
+	enum Kind { NONE, UNIFORM, GAUSSIAN, PINK, DRIFT };
+
+	Kind kind = NONE;
+	// Readings are 100/(d^2 + 100), ~0.2 at the target. Much above 3e-4 the
+	// noise swamps distant agents' readings and controlScale amplifies it into
+	// a runaway, so the defaults stay well under that
+	float sigma = 1e-4f;      // std dev of the white part
+	float driftRate = 2e-5f;  // DRIFT: bias std dev growth per sqrt(second)
+
+	// Per channel filter state, structure of arrays
+	std::vector<float> pink0, pink1, pink2, bias;
+
+	noise::Streams streams;
+	Rng fallback; // extra randoms for ziggurat rejections
+
+	SensorNoise() {
+		seed(0);
+	}
+
+	void seed(uint64_t seed) {
+		streams.seed(seed);
+		fallback.seed(seed, 0xfa11);
+	}
+
+	void resize(size_t channels) {
+		pink0.assign(channels, 0);
+		pink1.assign(channels, 0);
+		pink2.assign(channels, 0);
+		bias.assign(channels, 0);
+	}
+
+	size_t channels() const {
+		return bias.size();
+	}
+
+	// Writes one sample for every channel into out[0..channels())
+	void fill(float* out, float dT) {
+		fill(out, dT, channels());
+	}
+
+	// Same for only the first n channels; the rest keep their filter state
+	void fill(float* out, float dT, size_t n) {
+		switch (kind) {
+			case NONE:
+				for (size_t c = 0; c < n; c++) out[c] = 0;
+				break;
+			case UNIFORM:
+				uniform(out, n, sigma);
+				break;
+			case GAUSSIAN:
+				gaussian(out, n, sigma);
+				break;
+			case PINK:
+				gaussian(out, n, sigma);
+				for (size_t c = 0; c < n; c++) {
+					float white = out[c];
+					pink0[c] = 0.99765f * pink0[c] + white * 0.0990460f;
+					pink1[c] = 0.96300f * pink1[c] + white * 0.2965164f;
+					pink2[c] = 0.57000f * pink2[c] + white * 1.0526913f;
+					// the filter's stationary std dev is 2.98x its input's, normalise back to sigma
+					out[c] = (pink0[c] + pink1[c] + pink2[c] + white * 0.1848f) * 0.3357f;
+				}
+				break;
+			case DRIFT: {
+				gaussian(out, n, sigma);
+				// a second Gaussian per channel drives the bias random walk
+				float step = driftRate * sqrtf(dT);
+				for (size_t start = 0; start < n; start += CHUNK) {
+					size_t length = n - start < CHUNK ? n - start : CHUNK;
+					float walk[CHUNK];
+					gaussian(walk, length, step);
+					for (size_t c = 0; c < length; c++) {
+						bias[start + c] += walk[c];
+						out[start + c] += bias[start + c];
+					}
+				}
+				break;
+			}
+		}
+	}
+
+	// Exchanges the filter state of two channels, for callers that reorder them
+	void swapChannels(size_t a, size_t b) {
+		std::swap(pink0[a], pink0[b]);
+		std::swap(pink1[a], pink1[b]);
+		std::swap(pink2[a], pink2[b]);
+		std::swap(bias[a], bias[b]);
+	}
+
+	private:
+	// Random words are generated a chunk at a time into a stack buffer
+	static const size_t CHUNK = 256;
+
+	// |hz| without branches (or overflow at INT32_MIN)
+	static uint32_t magnitude(int32_t hz) {
+		uint32_t sign = (uint32_t)(hz >> 31);
+		return ((uint32_t)hz ^ sign) - sign;
+	}
+
+	void uniform(float* out, size_t n, float scale) {
+		// sqrt(12) scale wide, centred on 0
+		float width = scale * 3.4641016f;
+		uint32_t bits[CHUNK];
+		for (size_t start = 0; start < n; start += CHUNK) {
+			size_t length = n - start < CHUNK ? n - start : CHUNK;
+			streams.next(bits, length);
+			for (size_t c = 0; c < length; c++) {
+				out[start + c] = ((bits[c] >> 8) * (1.0f / 16777216.0f) - 0.5f) * width;
+			}
+		}
+	}
+
+	// A word splits into a layer (top 8 bits) and a signed position within it
+	static uint32_t layer(uint32_t word) {
+		return word >> 24;
+	}
+
+	static int32_t position(uint32_t word) {
+		return (int32_t)(word << 8);
+	}
+
+	void gaussian(float* out, size_t n, float scale) {
+		const noise::Ziggurat &z = noise::ziggurat();
+		uint32_t bits[CHUNK];
+		float samples[CHUNK]; // local, so the compiler knows writes don't touch the tables
+		for (size_t start = 0; start < n; start += CHUNK) {
+			size_t length = n - start < CHUNK ? n - start : CHUNK;
+			streams.next(bits, length);
+			// Fast path for every sample without branches. Rejected samples are
+			// flagged with a NaN by masking the bits (a float select would branch)
+			for (size_t c = 0; c < length; c++) {
+				uint32_t iz = layer(bits[c]);
+				int32_t hz = position(bits[c]);
+				float x = hz * z.w[iz];
+				uint32_t xBits, keep = 0u - (uint32_t)(magnitude(hz) < z.k[iz]);
+				memcpy(&xBits, &x, sizeof(x));
+				xBits = (xBits & keep) | (0x7fc00000u & ~keep);
+				memcpy(&samples[c], &xBits, sizeof(x));
+			}
+			for (size_t c = 0; c < length; c++) {
+				float x = samples[c];
+				if (x != x) x = rejected(position(bits[c]), layer(bits[c]));
+				out[start + c] = x * scale;
+			}
+		}
+	}
+
+	// The rest of the ziggurat (wedges and tail) for a sample whose fast path failed
+	float rejected(int32_t hz, uint32_t iz) {
+		const noise::Ziggurat &z = noise::ziggurat();
+		const float r = 3.6541529f;
+		while (true) {
+			float x = hz * z.w[iz];
+			if (iz == 0) {
+				// tail beyond r
+				float tx, ty;
+				do {
+					tx = -logf(1.0f - fallback.uniform()) / r;
+					ty = -logf(1.0f - fallback.uniform());
+				} while (ty + ty < tx * tx);
+				return hz > 0 ? r + tx : -r - tx;
+			}
+			if (z.f[iz] + fallback.uniform() * (z.f[iz - 1] - z.f[iz]) < expf(-0.5f * x * x)) return x;
+			// start over with fresh bits
+			uint32_t word = fallback.next();
+			iz = layer(word);
+			hz = position(word);
+			if (magnitude(hz) < z.k[iz]) return hz * z.w[iz];
+		}
+	}
+};
+
+// Noise kinds accepted by makeSensorNoise, for usage messages
+inline const char* noiseNames() {
+	return "none uniform gaussian pink drift";
+}
+
+inline bool makeSensorNoise(const std::string &name, SensorNoise &noise) {
+	if (name == "none") noise.kind = SensorNoise::NONE;
+	else if (name == "uniform") noise.kind = SensorNoise::UNIFORM;
+	else if (name == "gaussian") noise.kind = SensorNoise::GAUSSIAN;
+	else if (name == "pink") noise.kind = SensorNoise::PINK;
+	else if (name == "drift") noise.kind = SensorNoise::DRIFT;
+	else return false;
+	return true;
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <type_traits>
+#include <utility>
+
+#include "fixed.h"
+#include "vec2.h"
+#include "pid.h"
+#include "vec2xn.h"
+
+template<typename T>
+T getSensorValueAtPoint(const T &displacement) {
+	return T(100)/(displacement + T(100)); // prop to 1/r
+}
+
+// A sensor array with its pair of controllers. Sensors go from top, clockwise
+template<typename T>
+struct AgentT {
+	Vec2T<T> pos;
+	Vec2T<T> vel;
+	PIDControllerT<T> xPID = PIDControllerT<T>(T(0.25), T(0.1), T(0.1));
+	PIDControllerT<T> yPID = PIDControllerT<T>(T(0.25), T(0.1), T(0.1));
+	T sensorValues[4] = {T(0), T(0), T(0), T(0)};
+	T errorX = T(0);
+	T errorY = T(0);
+	T sensorOffset = T(20);
+};
+
+typedef AgentT<float> Agent;
+
+// Controller output multiplier: larger when the light is dim (far from the target)
+template<typename T>
+T controlScale(const T sensorValues[4]) {
+	T avgSensorValue = (sensorValues[0] + sensorValues[1] + sensorValues[2] + sensorValues[3]) / T(4);
+	T scale = avgSensorValue == T(0) ? T(1) : T(0.01)/(avgSensorValue) + T(0.08);
+	// constrain scale
+	scale = scale > T(10e3) ? T(10e3) : scale;
+	scale = scale < T(1) ? T(1) : scale;
+	return scale;
+}
+
+// Recomputes the agent's errors from its current sensor readings
+template<typename T>
+void updateErrors(AgentT<T> &agent) {
+	agent.errorY = T(200)*(agent.sensorValues[2] - agent.sensorValues[0]);
+	agent.errorX = T(-200)*(agent.sensorValues[3] - agent.sensorValues[1]);
+}
+
+// Reads the four sensors at the agent's position and updates its errors.
+// noise, if given, is added to the four readings (see noise.h)
+template<typename T>
+void readSensors(AgentT<T> &agent, const Vec2T<T> &target, const float* noise = nullptr) {
+	// note the sensor model is fed the squared distance
+	T off = agent.sensorOffset;
+	T dx = target.x - agent.pos.x;
+	T dy = target.y - agent.pos.y;
+	if (!std::is_floating_point<T>::value) {
+		// A fixed point square saturates a few hundred px out (Q16.16 at ~181),
+		// so square tenths of a px instead: 100/(d*d + 100) == 1/((d/10)^2 + 1)
+		const T tenth = T(0.1);
+		dx = dx * tenth;
+		dy = dy * tenth;
+		off = off * tenth;
+		agent.sensorValues[0] = T(1)/(dx*dx + (dy + off)*(dy + off) + T(1)); // top
+		agent.sensorValues[1] = T(1)/((dx - off)*(dx - off) + dy*dy + T(1)); // right
+		agent.sensorValues[2] = T(1)/(dx*dx + (dy - off)*(dy - off) + T(1)); // bottom
+		agent.sensorValues[3] = T(1)/((dx + off)*(dx + off) + dy*dy + T(1)); // left
+	} else {
+		agent.sensorValues[0] = getSensorValueAtPoint(dx*dx + (dy + off)*(dy + off)); // top
+		agent.sensorValues[1] = getSensorValueAtPoint((dx - off)*(dx - off) + dy*dy); // right
+		agent.sensorValues[2] = getSensorValueAtPoint(dx*dx + (dy - off)*(dy - off)); // bottom
+		agent.sensorValues[3] = getSensorValueAtPoint((dx + off)*(dx + off) + dy*dy); // left
+	}
+	if (noise) {
+		for (int s = 0; s < 4; s++) agent.sensorValues[s] += T(noise[s]);
+	}
+	updateErrors(agent);
+}
+
+// Runs the controllers on the current errors and applies their output to the
+// velocity. Returns the control applied (the change in velocity)
+template<typename T>
+Vec2T<T> applyControl(AgentT<T> &agent, T dT) {
+	T scale = controlScale(agent.sensorValues);
+	
+	Vec2T<T> control(scale * agent.xPID.update(agent.errorX, dT), scale * agent.yPID.update(agent.errorY, dT));
+	agent.vel += control;
+	return control;
+}
+
+template<typename T>
+void moveAgent(AgentT<T> &agent, T dT) {
+	agent.pos.x += agent.vel.x * dT;
+	agent.pos.y += agent.vel.y * dT;
+}
+
+// Advances one agent by dT towards target: the controllers act on the errors
+// from the previous step, then the sensors are re-read at the new position.
+// Returns the control applied (the change in velocity)
+template<typename T>
+Vec2T<T> stepAgent(AgentT<T> &agent, Vec2T<T> target, T dT, const float* sensorNoise = nullptr) {
+	Vec2T<T> control = applyControl(agent, dT);
+	moveAgent(agent, dT);
+	readSensors(agent, target, sensorNoise);
+	return control;
+}
+
+// N agents stored structure-of-arrays style, stepped together with packed maths
+template<int N>
+struct AgentBlockT {
+	Vec2xN<N> pos;
+	Vec2xN<N> vel;
+	PIDControllerT<FloatN<N>> xPID = PIDControllerT<FloatN<N>>(0.25f, 0.1f, 0.1f);
+	PIDControllerT<FloatN<N>> yPID = PIDControllerT<FloatN<N>>(0.25f, 0.1f, 0.1f);
+	FloatN<N> sensorValues[4];
+	FloatN<N> errorX;
+	FloatN<N> errorY;
+	FloatN<N> sensorOffset = FloatN<N>(20);
+};
+
+typedef AgentBlockT<SIM_LANES> AgentBlock;
+
+// Exchanges one agent between two lanes (of the same or different blocks)
+template<int N>
+void swapLanes(AgentBlockT<N> &a, int i, AgentBlockT<N> &b, int j) {
+	auto swapLane = [&](FloatN<N> &x, FloatN<N> &y) { std::swap(x.v[i], y.v[j]); };
+	swapLane(a.pos.x, b.pos.x);
+	swapLane(a.pos.y, b.pos.y);
+	swapLane(a.vel.x, b.vel.x);
+	swapLane(a.vel.y, b.vel.y);
+	PIDControllerT<FloatN<N>>* pidsA[2] = {&a.xPID, &a.yPID};
+	PIDControllerT<FloatN<N>>* pidsB[2] = {&b.xPID, &b.yPID};
+	for (int k = 0; k < 2; k++) {
+		swapLane(pidsA[k]->p, pidsB[k]->p);
+		swapLane(pidsA[k]->i, pidsB[k]->i);
+		swapLane(pidsA[k]->d, pidsB[k]->d);
+		swapLane(pidsA[k]->integral, pidsB[k]->integral);
+		swapLane(pidsA[k]->lastError, pidsB[k]->lastError);
+	}
+	for (int s = 0; s < 4; s++) swapLane(a.sensorValues[s], b.sensorValues[s]);
+	swapLane(a.errorX, b.errorX);
+	swapLane(a.errorY, b.errorY);
+	swapLane(a.sensorOffset, b.sensorOffset);
+}
+
+// Same step as stepAgent, for every lane of a block at once. sensorNoise, if
+// given, holds 4 * N samples, sensor major (all lanes' top readings first)
+template<int N>
+void stepAgentBlock(AgentBlockT<N> &block, const Vec2xN<N> &target, float dT, const float* sensorNoise = nullptr) {
+	typedef FloatN<N> F;
+	
+	// calculate scale
+	F avgSensorValue = (block.sensorValues[0] + block.sensorValues[1] + block.sensorValues[2] + block.sensorValues[3]) * F(0.25f);
+	F scale = select(avgSensorValue == F(0), F(1), F(0.01f)/avgSensorValue + F(0.08f));
+	// constrain scale
+	scale = max(min(scale, F(10e3f)), F(1));
+	
+	block.vel.x += scale * block.xPID.update(block.errorX, F(dT));
+	block.vel.y += scale * block.yPID.update(block.errorY, F(dT));
+	
+	block.pos = fma(block.vel, F(dT), block.pos);
+	
+	// get sensor values and errors, squared distances as in stepAgent
+	Vec2xN<N> d = target - block.pos;
+	Vec2xN<N> offX(block.sensorOffset, F(0));
+	Vec2xN<N> offY(F(0), block.sensorOffset);
+	block.sensorValues[0] = getSensorValueAtPoint((d + offY).magnitude_squared()); // top
+	block.sensorValues[1] = getSensorValueAtPoint((d - offX).magnitude_squared()); // right
+	block.sensorValues[2] = getSensorValueAtPoint((d - offY).magnitude_squared()); // bottom
+	block.sensorValues[3] = getSensorValueAtPoint((d + offX).magnitude_squared()); // left
+	if (sensorNoise) {
+		for (int s = 0; s < 4; s++) block.sensorValues[s] += F::load(sensorNoise + s * N);
+	}
+	block.errorY = F(200)*(block.sensorValues[2] - block.sensorValues[0]);
+	block.errorX = F(-200)*(block.sensorValues[3] - block.sensorValues[1]);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+template<typename T>
+class PIDControllerT {
+	public:
+	T p, i, d;
+	T integral, lastError;
+	
+	PIDControllerT(const T& p, const T& i, const T& d) {
+		this->p = p;
+		this->i = i;
+		this->d = d;
+		integral = T(0);
+		lastError = T(0);
+	}
+	
+	T update(const T& error, const T& dT) {
+		integral += error * dT;
+		T derivative = (error - lastError) / dT;
+		lastError = error;
+		return p*error + i*integral + d*derivative;
+	}
+};
+
+typedef PIDControllerT<float> PIDController;
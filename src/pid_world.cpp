@@ -0,0 +1,152 @@
+// The PID-Controller-world library: pid_world.h's C interface over the
+// packed agent physics, sensor model and controllers (physics.h, pid.h).
+// Agent k lives in lane k % SIM_LANES of block k / SIM_LANES, with its own
+// gains and target, and every block is stepped with stepAgentBlock. No C++
+// exception ever crosses the interface.
+//
+// The last block's lanes past the last agent are stepped along with it:
+// they share its packed instructions, so skipping them would save nothing.
+// They are kept idle (zero gains, so they never move) until an agent is
+// added into them.
+
+#define PID_WORLD_BUILD
+#include "pid_world.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <exception>
+#include <new>
+#include <vector>
+
+#include "physics.h"
+
+struct PidWorld {
+	std::vector<AgentBlock> blocks;
+	std::vector<Vec2Pack> targets; // per block
+	size_t agents = 0;
+	Vec2 target; // for agents added from now on
+};
+
+namespace {
+	// Whether agents first to first + count - 1 exist
+	bool inRange(const PidWorld* world, size_t first, size_t count) {
+		return world && first <= world->agents && count <= world->agents - first;
+	}
+}
+
+uint32_t pid_world_abi_version(void) {
+	return PID_WORLD_ABI_VERSION;
+}
+
+PidWorld* pid_world_create(void) {
+	return new (std::nothrow) PidWorld();
+}
+
+void pid_world_destroy(PidWorld* world) {
+	delete world;
+}
+
+int64_t pid_world_add_agents(PidWorld* world, size_t count, const float* positions) {
+	if (!world) return PID_WORLD_ERROR_ARGUMENT;
+	size_t first = world->agents;
+	// agent numbers must fit the int64_t returned, and the block count
+	// must neither wrap nor pass what a vector can hold
+	size_t mostBlocks = std::min({world->blocks.max_size(), world->targets.max_size(), SIZE_MAX / SIM_LANES});
+	size_t most = std::min((size_t)INT64_MAX, mostBlocks * SIM_LANES);
+	if (count > most - first) return PID_WORLD_ERROR_ARGUMENT;
+	size_t blocks = (first + count + SIM_LANES - 1) / SIM_LANES;
+	try {
+		world->blocks.reserve(blocks);
+		world->targets.reserve(blocks);
+	} catch (const std::bad_alloc&) {
+		return PID_WORLD_ERROR_MEMORY;
+	} catch (const std::exception&) {
+		return PID_WORLD_ERROR_ARGUMENT;
+	}
+	// new blocks start with every lane idle, and each new agent swaps in a
+	// fresh lane, whatever the idle lane it replaces went through
+	AgentBlock fresh, idle;
+	for (PIDControllerT<FloatPack>* pid : {&idle.xPID, &idle.yPID}) {
+		pid->p = pid->i = pid->d = FloatPack(0);
+	}
+	while (world->blocks.size() < blocks) {
+		world->blocks.push_back(idle);
+		world->targets.emplace_back(world->target);
+	}
+	for (size_t k = first; k < first + count; k++) {
+		AgentBlock &block = world->blocks[k / SIM_LANES];
+		int lane = (int)(k % SIM_LANES);
+		AgentBlock spare = fresh;
+		swapLanes(block, lane, spare, lane);
+		block.pos.setLane(lane, positions ? Vec2(positions[2 * (k - first)], positions[2 * (k - first) + 1]) : Vec2(0, 0));
+		world->targets[k / SIM_LANES].setLane(lane, world->target);
+	}
+	world->agents += count;
+	return (int64_t)first;
+}
+
+size_t pid_world_agent_count(const PidWorld* world) {
+	return world ? world->agents : 0;
+}
+
+int pid_world_set_gains(PidWorld* world, size_t first, size_t count, const PidGains* gains) {
+	if (!inRange(world, first, count) || (count && !gains)) return PID_WORLD_ERROR_ARGUMENT;
+	for (size_t k = 0; k < count; k++) {
+		AgentBlock &block = world->blocks[(first + k) / SIM_LANES];
+		int lane = (int)((first + k) % SIM_LANES);
+		for (PIDControllerT<FloatPack>* pid : {&block.xPID, &block.yPID}) {
+			pid->p[lane] = gains[k].p;
+			pid->i[lane] = gains[k].i;
+			pid->d[lane] = gains[k].d;
+		}
+	}
+	return PID_WORLD_OK;
+}
+
+int pid_world_set_target(PidWorld* world, float x, float y) {
+	if (!world) return PID_WORLD_ERROR_ARGUMENT;
+	world->target = Vec2(x, y);
+	for (Vec2Pack &target : world->targets) target = Vec2Pack(world->target);
+	return PID_WORLD_OK;
+}
+
+int pid_world_set_targets(PidWorld* world, size_t first, size_t count, const float* targets) {
+	if (!inRange(world, first, count) || (count && !targets)) return PID_WORLD_ERROR_ARGUMENT;
+	for (size_t k = 0; k < count; k++) {
+		world->targets[(first + k) / SIM_LANES].setLane((int)((first + k) % SIM_LANES), Vec2(targets[2 * k], targets[2 * k + 1]));
+	}
+	return PID_WORLD_OK;
+}
+
+int pid_world_step(PidWorld* world, uint32_t steps, float dt) {
+	if (!world || !(dt > 0) || !std::isfinite(dt)) return PID_WORLD_ERROR_ARGUMENT;
+	for (uint32_t s = 0; s < steps; s++) {
+		for (size_t b = 0; b < world->blocks.size(); b++) {
+			stepAgentBlock(world->blocks[b], world->targets[b], dt);
+		}
+	}
+	return PID_WORLD_OK;
+}
+
+int pid_world_read_state(const PidWorld* world, size_t first, size_t count,
+	float* positions, float* velocities, float* errors) {
+	if (!inRange(world, first, count)) return PID_WORLD_ERROR_ARGUMENT;
+	for (size_t k = 0; k < count; k++) {
+		const AgentBlock &block = world->blocks[(first + k) / SIM_LANES];
+		int lane = (int)((first + k) % SIM_LANES);
+		if (positions) {
+			positions[2 * k] = block.pos.x[lane];
+			positions[2 * k + 1] = block.pos.y[lane];
+		}
+		if (velocities) {
+			velocities[2 * k] = block.vel.x[lane];
+			velocities[2 * k + 1] = block.vel.y[lane];
+		}
+		if (errors) {
+			errors[2 * k] = block.errorX[lane];
+			errors[2 * k + 1] = block.errorY[lane];
+		}
+	}
+	return PID_WORLD_OK;
+}
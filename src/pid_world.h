@@ -0,0 +1,90 @@
+#pragma once
+
+// C interface to the agent physics, sensor model and PID controllers, for
+// driving large batches of agents from other programs without the GUI.
+// Build the PID-Controller-world library target and include this header
+// from C or C++.
+//
+//     PidWorld* world = pid_world_create();
+//     pid_world_add_agents(world, n, startPositions);
+//     pid_world_set_gains(world, 0, n, gains);
+//     pid_world_set_target(world, 540, 360);
+//     pid_world_step(world, 600, 1.0f / 120);
+//     pid_world_read_state(world, 0, n, positions, velocities, NULL);
+//     pid_world_destroy(world);
+//
+// Agents are numbered from 0 in the order they were added. Vectors are
+// passed as interleaved x, y float pairs, so n agents take 2 * n floats.
+// Reads write straight from the packed agent state into the caller's
+// buffers, and nothing allocates after the agents have been added.
+//
+// Functions returning int give PID_WORLD_OK or a negative PID_WORLD_ERROR_*
+// and leave the world unchanged on error. A world must only be used by one
+// thread at a time; separate worlds are independent.
+//
+// Only functions are exported and PidWorld stays opaque, so existing calls
+// keep working across releases with the same PID_WORLD_ABI_VERSION.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+	#if defined(PID_WORLD_BUILD)
+		#define PID_WORLD_API __declspec(dllexport)
+	#else
+		#define PID_WORLD_API __declspec(dllimport)
+	#endif
+#else
+	#define PID_WORLD_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PID_WORLD_ABI_VERSION 1
+
+#define PID_WORLD_OK 0
+#define PID_WORLD_ERROR_ARGUMENT -1 // null world, agents out of range, too many agents or a bad time step
+#define PID_WORLD_ERROR_MEMORY -2
+
+typedef struct PidWorld PidWorld;
+
+typedef struct PidGains {
+	float p, i, d;
+} PidGains;
+
+// PID_WORLD_ABI_VERSION of the library actually loaded
+PID_WORLD_API uint32_t pid_world_abi_version(void);
+
+// An empty world, or NULL if out of memory
+PID_WORLD_API PidWorld* pid_world_create(void);
+PID_WORLD_API void pid_world_destroy(PidWorld* world);
+
+// Adds count agents at rest at positions (2 * count floats, or NULL for the
+// origin) with the default gains and the world's current target. Returns
+// the number of the first new agent, or a negative PID_WORLD_ERROR_*
+PID_WORLD_API int64_t pid_world_add_agents(PidWorld* world, size_t count, const float* positions);
+PID_WORLD_API size_t pid_world_agent_count(const PidWorld* world);
+
+// Gains of agents first to first + count - 1, one PidGains each. Resets
+// nothing else, so integrals carry on
+PID_WORLD_API int pid_world_set_gains(PidWorld* world, size_t first, size_t count, const PidGains* gains);
+
+// The same target for every agent, present and future
+PID_WORLD_API int pid_world_set_target(PidWorld* world, float x, float y);
+// A target per agent, 2 * count floats
+PID_WORLD_API int pid_world_set_targets(PidWorld* world, size_t first, size_t count, const float* targets);
+
+// Advances every agent steps times by dt seconds (dt > 0)
+PID_WORLD_API int pid_world_step(PidWorld* world, uint32_t steps, float dt);
+
+// Copies the state of agents first to first + count - 1 into whichever of
+// positions, velocities and errors (x and y controller errors) are not NULL,
+// 2 * count floats each
+PID_WORLD_API int pid_world_read_state(const PidWorld* world, size_t first, size_t count,
+	float* positions, float* velocities, float* errors);
+
+#ifdef __cplusplus
+}
+#endif
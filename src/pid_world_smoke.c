@@ -0,0 +1,66 @@
+// Plain C99 user of the PID-Controller-world library: checks that
+// pid_world.h compiles as C, that the library links from C, and that the
+// calls behave. Runs every check and exits non-zero if any failed.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "pid_world.h"
+
+#define AGENTS 1000
+
+static int failures = 0;
+
+static void check(int ok, const char* what) {
+	if (!ok) {
+		fprintf(stderr, "FAIL: %s\n", what);
+		failures++;
+	}
+}
+
+int main(void) {
+	static float positions[2 * AGENTS], velocities[2 * AGENTS];
+	check(pid_world_abi_version() == PID_WORLD_ABI_VERSION, "ABI version matches the header");
+
+	PidWorld* world = pid_world_create();
+	if (!world) {
+		fprintf(stderr, "FAIL: creating a world\n");
+		return 1;
+	}
+
+	// a grid around the target, which every agent should settle on
+	for (size_t k = 0; k < AGENTS; k++) {
+		positions[2 * k] = 40.0f + (float)(k % 40) * 25;
+		positions[2 * k + 1] = 60.0f + (float)(k / 40) * 25;
+	}
+	check(pid_world_add_agents(world, AGENTS, positions) == 0, "first agents are numbered from 0");
+	PidGains gains = {0.3f, 0.1f, 0.1f};
+	for (size_t k = 0; k < AGENTS; k++) {
+		check(pid_world_set_gains(world, k, 1, &gains) == PID_WORLD_OK, "setting gains");
+	}
+	check(pid_world_set_target(world, 540, 360) == PID_WORLD_OK, "setting the target");
+	check(pid_world_step(world, 1200, 1.0f / 120) == PID_WORLD_OK, "stepping");
+
+	// bad arguments are refused and change nothing
+	check(pid_world_step(world, 1, 0) == PID_WORLD_ERROR_ARGUMENT, "a zero time step is refused");
+	check(pid_world_read_state(world, AGENTS, 1, positions, NULL, NULL) == PID_WORLD_ERROR_ARGUMENT, "reading past the last agent is refused");
+	check(pid_world_add_agents(world, SIZE_MAX, NULL) == PID_WORLD_ERROR_ARGUMENT, "SIZE_MAX agents are refused");
+	int64_t huge = pid_world_add_agents(world, (size_t)1 << 60, NULL);
+	check(huge == PID_WORLD_ERROR_ARGUMENT || huge == PID_WORLD_ERROR_MEMORY, "2^60 agents are refused");
+	check(pid_world_agent_count(world) == AGENTS, "refused calls add no agents");
+	check(pid_world_add_agents(world, 3, NULL) == AGENTS, "later agents are numbered on");
+
+	check(pid_world_read_state(world, 0, AGENTS, positions, velocities, NULL) == PID_WORLD_OK, "reading state");
+	float worst = 0;
+	for (size_t k = 0; k < AGENTS; k++) {
+		float dx = positions[2 * k] - 540, dy = positions[2 * k + 1] - 360;
+		if (dx * dx + dy * dy > worst) worst = dx * dx + dy * dy;
+	}
+	check(worst < 10 * 10, "every agent ends within 10 px of the target");
+	pid_world_destroy(world);
+
+	if (failures) return 1;
+	printf("PID-Controller-world: %d agents settled, worst %.3f px from the target\n", AGENTS, sqrtf(worst));
+	return 0;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+
+// PCG32 random number generator (pcg-random.org). Small, fast and its whole
+// state is two integers, so it can be saved and restored with the simulation.
+// Unlike rand(), every Simulation owns its own stream, so runs are reproducible.
+struct Rng {
+	uint64_t state = 0x853c49e6748fea9bULL;
+	uint64_t inc = 0xda3e39cb94b95bdbULL;
+
+	Rng() {}
+
+	Rng(uint64_t seed, uint64_t stream = 54) {
+		this->seed(seed, stream);
+	}
+
+	void seed(uint64_t seed, uint64_t stream = 54) {
+		state = 0;
+		inc = (stream << 1) | 1;
+		next();
+		state += seed;
+		next();
+	}
+
+	uint32_t next() {
+		uint64_t old = state;
+		state = old * 6364136223846793005ULL + inc;
+		uint32_t xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+		uint32_t rot = (uint32_t)(old >> 59);
+		return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+	}
+
+	// Uniform in [0, 1)
+	float uniform() {
+		return (next() >> 8) * (1.0f / 16777216.0f);
+	}
+
+	// Uniform in [lo, hi)
+	float uniform(float lo, float hi) {
+		return lo + (hi - lo) * uniform();
+	}
+};
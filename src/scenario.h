@@ -0,0 +1,210 @@
+#pragma once
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "vec2.h"
+#include "rng.h"
+
+// Target trajectories for runs without a mouse.
+// A Scenario is a streaming generator: next(dT) advances it by one step and
+// returns the target, so nothing is ever materialised and memory stays
+// constant however long the run. Make one by name with makeScenario().
+
+class Scenario {
+	public:
+	virtual ~Scenario() {}
+
+	// Advances by dT seconds and returns the target for that step
+	Vec2 next(float dT) {
+		time += dT;
+		return at(time);
+	}
+
+	protected:
+	double time = 0;
+
+	virtual Vec2 at(double t) = 0;
+};
+
+// Stays at one point
+class HoldScenario : public Scenario {
+	public:
+	Vec2 point;
+	HoldScenario(Vec2 point) : point(point) {}
+	protected:
+	Vec2 at(double /*t*/) override { return point; }
+};
+
+// Jumps from one point to another at stepTime
+class StepScenario : public Scenario {
+	public:
+	Vec2 from, to;
+	double stepTime;
+	StepScenario(Vec2 from, Vec2 to, double stepTime) : from(from), to(to), stepTime(stepTime) {}
+	protected:
+	Vec2 at(double t) override { return t < stepTime ? from : to; }
+};
+
+// Moves at constant speed from one point to another over duration, then holds
+class RampScenario : public Scenario {
+	public:
+	Vec2 from, to;
+	double duration;
+	RampScenario(Vec2 from, Vec2 to, double duration) : from(from), to(to), duration(duration) {}
+	protected:
+	Vec2 at(double t) override {
+		float k = t >= duration ? 1.0f : (float)(t / duration);
+		return from + (to - from) * k;
+	}
+};
+
+// centre + (amplitude.x sin(a w t + phase), amplitude.y sin(b w t)), w = 2 pi / period.
+// Covers sine (b = 0), circle (a = b, phase = pi/2) and Lissajous figures
+class LissajousScenario : public Scenario {
+	public:
+	Vec2 centre, amplitude;
+	float a, b, phase;
+	double period;
+	LissajousScenario(Vec2 centre, Vec2 amplitude, float a, float b, float phase, double period)
+		: centre(centre), amplitude(amplitude), a(a), b(b), phase(phase), period(period) {}
+	protected:
+	Vec2 at(double t) override {
+		double w = 2 * M_PI / period;
+		return centre + Vec2(amplitude.x * (float)sin(a * w * t + phase), amplitude.y * (float)sin(b * w * t));
+	}
+};
+
+// Wanders with a randomly perturbed velocity, kept inside bounds.
+// Seeded, so a named random walk is the same every run
+class RandomWalkScenario : public Scenario {
+	public:
+	Vec2 pos, vel;
+	Vec2 boundsMin, boundsMax;
+	float accel, maxSpeed;
+	Rng rng;
+	RandomWalkScenario(Vec2 start, Vec2 boundsMin, Vec2 boundsMax, float accel, float maxSpeed, uint64_t seed)
+		: pos(start), boundsMin(boundsMin), boundsMax(boundsMax), accel(accel), maxSpeed(maxSpeed), rng(seed) {}
+	protected:
+	double lastTime = 0;
+	Vec2 at(double t) override {
+		float dT = (float)(t - lastTime);
+		lastTime = t;
+		vel += Vec2(rng.uniform(-1, 1), rng.uniform(-1, 1)) * (accel * dT);
+		float speedSquared = vel.magnitude_squared();
+		if (speedSquared > maxSpeed * maxSpeed) {
+			vel = vel * (maxSpeed / sqrtf(speedSquared));
+		}
+		pos += vel * dT;
+		// bounce off the bounds
+		if (pos.x < boundsMin.x || pos.x > boundsMax.x) vel.x = -vel.x;
+		if (pos.y < boundsMin.y || pos.y > boundsMax.y) vel.y = -vel.y;
+		pos.x = fminf(fmaxf(pos.x, boundsMin.x), boundsMax.x);
+		pos.y = fminf(fmaxf(pos.y, boundsMin.y), boundsMax.y);
+		return pos;
+	}
+};
+
+// Replays a recorded trajectory: one "t x y" line per sample, t in seconds
+// and increasing. Lines are read only as time reaches them and interpolated
+// linearly; the last sample is held once the file runs out
+class FileScenario : public Scenario {
+	public:
+	FileScenario(const std::string &path) : file(path) {
+		readSample(t0, p0);
+		t1 = t0;
+		p1 = p0;
+		readSample(t1, p1);
+	}
+
+	bool isOpen() const { return file.is_open(); }
+
+	protected:
+	std::ifstream file;
+	double t0 = 0, t1 = 0;
+	Vec2 p0, p1;
+
+	bool readSample(double &t, Vec2 &p) {
+		std::string line;
+		while (std::getline(file, line)) {
+			if (line.empty() || line[0] == '#') continue;
+			std::istringstream fields(line);
+			double ts;
+			float x, y;
+			if (fields >> ts >> x >> y) {
+				t = ts;
+				p = Vec2(x, y);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	Vec2 at(double t) override {
+		while (t > t1) {
+			double nextT;
+			Vec2 nextP;
+			if (!readSample(nextT, nextP)) return p1;
+			t0 = t1; p0 = p1;
+			t1 = nextT; p1 = nextP;
+		}
+		if (t <= t0 || t1 <= t0) return p0;
+		return p0 + (p1 - p0) * (float)((t - t0) / (t1 - t0));
+	}
+};
+
+// Names accepted by makeScenario, for usage messages
+inline const char* scenarioNames() {
+	return "hold[:X,Y] step ramp sine circle lissajous randomwalk[:SEED] file:PATH";
+}
+
+// Builds a scenario from "name" or "name:args", sized for the 1080x720 window.
+// Returns nullptr for unknown names or unreadable files
+inline std::unique_ptr<Scenario> makeScenario(const std::string &spec) {
+	std::string name = spec.substr(0, spec.find(':'));
+	std::string args = spec.find(':') == std::string::npos ? "" : spec.substr(spec.find(':') + 1);
+	Vec2 centre = Vec2(1080, 720) / 2;
+
+	if (name == "hold") {
+		Vec2 point(1080*3/4, 720/4);
+		if (!args.empty()) {
+			point.x = (float)atof(args.c_str());
+			size_t comma = args.find(',');
+			if (comma != std::string::npos) point.y = (float)atof(args.c_str() + comma + 1);
+		}
+		return std::unique_ptr<Scenario>(new HoldScenario(point));
+	}
+	if (name == "step") {
+		return std::unique_ptr<Scenario>(new StepScenario(centre, centre + Vec2(250, -150), 1.0));
+	}
+	if (name == "ramp") {
+		return std::unique_ptr<Scenario>(new RampScenario(Vec2(200, 360), Vec2(880, 360), 5.0));
+	}
+	if (name == "sine") {
+		return std::unique_ptr<Scenario>(new LissajousScenario(centre, Vec2(300, 0), 1, 0, 0, 4.0));
+	}
+	if (name == "circle") {
+		return std::unique_ptr<Scenario>(new LissajousScenario(centre, Vec2(200, 200), 1, 1, (float)M_PI/2, 6.0));
+	}
+	if (name == "lissajous") {
+		return std::unique_ptr<Scenario>(new LissajousScenario(centre, Vec2(400, 250), 3, 2, (float)M_PI/2, 20.0));
+	}
+	if (name == "randomwalk") {
+		uint64_t seed = args.empty() ? 1 : strtoull(args.c_str(), nullptr, 10);
+		return std::unique_ptr<Scenario>(new RandomWalkScenario(centre, Vec2(50, 50), Vec2(1030, 670), 400, 150, seed));
+	}
+	if (name == "file") {
+		FileScenario* scenario = new FileScenario(args);
+		if (!scenario->isOpen()) {
+			delete scenario;
+			return nullptr;
+		}
+		return std::unique_ptr<Scenario>(scenario);
+	}
+	return nullptr;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+
+// Runs STAGES periodic stages, each at its own period, in time order.
+// Pending events sit in a binary min-heap keyed on (due time, stage), so
+// advancing costs O(log STAGES) per stage run whatever the mix of rates, and
+// stages due at the same instant run in stage order. Times are integer
+// nanoseconds so periods don't drift against each other. Plain data, so it
+// copies and saves with a Simulation.
+template<int STAGES>
+class MultiRateScheduler {
+	public:
+	struct Event {
+		uint64_t time;
+		int stage;
+
+		// heap order: earliest first, then lowest stage
+		bool operator>(const Event &other) const {
+			return time != other.time ? time > other.time : stage > other.stage;
+		}
+	};
+
+	uint64_t now = 0;
+	uint64_t periods[STAGES] = {};
+	// One pending event per stage, as a min-heap. Public so snapshots can save
+	// it; check valid() before running anything restored
+	Event events[STAGES] = {};
+
+	// Sets every stage's period and makes each first due one period from now
+	void reset(const uint64_t stagePeriods[STAGES]) {
+		for (int s = 0; s < STAGES; s++) {
+			periods[s] = std::max<uint64_t>(stagePeriods[s], 1);
+			events[s] = {now + periods[s], s};
+		}
+		std::make_heap(events, events + STAGES, std::greater<Event>());
+	}
+
+	// Runs run(stage, period) for every event due up to and including until,
+	// in order, then moves the clock to until
+	template<typename F>
+	void advance(uint64_t until, F run) {
+		while (events[0].time <= until) {
+			std::pop_heap(events, events + STAGES, std::greater<Event>());
+			Event &due = events[STAGES - 1];
+			now = due.time;
+			run(due.stage, periods[due.stage]);
+			due.time += periods[due.stage];
+			std::push_heap(events, events + STAGES, std::greater<Event>());
+		}
+		now = until;
+	}
+
+	// When the next stage runs
+	uint64_t nextDue() const {
+		return events[0].time;
+	}
+
+	// Whether reset() and advance() could have left it like this: no zero
+	// period, and every stage pending exactly once, in heap order, due within
+	// one of its periods from now
+	bool valid() const {
+		bool pending[STAGES] = {};
+		for (int s = 0; s < STAGES; s++) {
+			if (periods[s] == 0) return false;
+			int stage = events[s].stage;
+			if (stage < 0 || stage >= STAGES || pending[stage]) return false;
+			pending[stage] = true;
+			// anything else would take advance() arbitrarily long to catch up
+			if (events[s].time <= now || events[s].time - now > periods[stage]) return false;
+		}
+		return std::is_heap(events, events + STAGES, std::greater<Event>());
+	}
+};
+
+// The last N values pushed, for modelling a fixed latency of up to N - 1
+// samples without allocating
+template<typename T, int N>
+struct DelayLine {
+	T values[N] = {};
+	uint32_t head = 0; // where the next value goes
+
+	// Fills the whole line, so reads before it has filled return initial
+	void reset(const T &initial) {
+		for (int i = 0; i < N; i++) values[i] = initial;
+		head = 0;
+	}
+
+	void push(const T &value) {
+		values[head] = value;
+		head = (head + 1) % N;
+	}
+
+	// The value pushed delay pushes before the latest one (0: the latest)
+	const T& delayed(int delay) const {
+		return values[(head + 2 * N - 1 - std::min(delay, N - 1)) % N];
+	}
+};
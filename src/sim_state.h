@@ -0,0 +1,384 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "simulation.h"
+
+// Compact binary snapshot of a Simulation's complete state: agent position,
+// velocity, sensor readings, controller gains, integrals and last errors,
+// the RNG, the clock, the running metrics, the integrator, the sensor noise
+// generator and the stage scheduler with its sensor delay line. Restoring it
+// into any Simulation continues the run bit-for-bit, so one long warm-up can
+// be forked into many what-if runs:
+//
+//     std::vector<uint8_t> state;
+//     saveState(warmedUp, state);
+//     for (...) { Simulation branch; loadState(branch, state); branch.setGains(...); ... }
+//
+// Scalars are stored field by field (no struct padding) in native byte order
+// and the build's sim_real format, and loading a snapshot from a build with a
+// different PID_SCALAR is rejected. Loading checks every enum, index and
+// period before anything uses them, so a corrupt or crafted file is refused
+// rather than trusted.
+
+const uint32_t SIM_STATE_MAGIC = 0x53444950; // "PIDS"
+const uint16_t SIM_STATE_VERSION = 7;
+
+#if defined(PID_SCALAR_Q16_16)
+const uint8_t SIM_STATE_SCALAR = 1;
+#else
+const uint8_t SIM_STATE_SCALAR = 0;
+#endif
+
+namespace simstate {
+	template<typename T>
+	void put(std::vector<uint8_t> &out, const T &value) {
+		static_assert(std::is_trivially_copyable<T>::value, "only plain data goes in a snapshot");
+		const uint8_t* bytes = (const uint8_t*)&value;
+		out.insert(out.end(), bytes, bytes + sizeof(T));
+	}
+
+	// Reads sequentially, failing (and staying failed) on truncated input
+	struct Reader {
+		const uint8_t* data;
+		size_t size;
+		size_t offset = 0;
+		bool ok = true;
+
+		template<typename T>
+		void get(T &value) {
+			static_assert(std::is_trivially_copyable<T>::value, "only plain data goes in a snapshot");
+			if (!ok || offset + sizeof(T) > size) {
+				ok = false;
+				return;
+			}
+			memcpy(&value, data + offset, sizeof(T));
+			offset += sizeof(T);
+		}
+
+		// Any byte but 0 or 1 fails the read
+		void get(bool &value) {
+			uint8_t byte = 0;
+			get(byte);
+			if (byte > 1) ok = false;
+			value = byte == 1;
+		}
+
+		// An enum stored as int32_t, failing the read outside first to last
+		template<typename E>
+		void getEnum(E &value, E first, E last) {
+			int32_t raw = 0;
+			get(raw);
+			if (raw < (int32_t)first || raw > (int32_t)last) {
+				ok = false;
+				return;
+			}
+			value = (E)raw;
+		}
+	};
+
+	inline void put(std::vector<uint8_t> &out, bool value) {
+		put(out, (uint8_t)value);
+	}
+
+	template<typename E>
+	void putEnum(std::vector<uint8_t> &out, E value) {
+		put(out, (int32_t)value);
+	}
+
+	inline void putVec2(std::vector<uint8_t> &out, const Vec2 &v) {
+		put(out, v.x);
+		put(out, v.y);
+	}
+
+	inline void getVec2(Reader &in, Vec2 &v) {
+		in.get(v.x);
+		in.get(v.y);
+	}
+
+	inline void putMetrics(std::vector<uint8_t> &out, const RunMetrics &m) {
+		put(out, m.ise);
+		put(out, m.iae);
+		put(out, m.itae);
+		put(out, m.effort);
+		put(out, m.runStart);
+		put(out, m.peakError);
+		put(out, m.overshoot);
+		put(out, m.riseTime);
+		put(out, m.settlingTime);
+		put(out, m.started);
+		put(out, m.startTime);
+		putVec2(out, m.start);
+		putVec2(out, m.target);
+		putVec2(out, m.direction);
+		put(out, m.initialDistance);
+		put(out, m.riseStart);
+		put(out, m.settledSince);
+		putVec2(out, m.lastTarget);
+	}
+
+	inline void getMetrics(Reader &in, RunMetrics &m) {
+		in.get(m.ise);
+		in.get(m.iae);
+		in.get(m.itae);
+		in.get(m.effort);
+		in.get(m.runStart);
+		in.get(m.peakError);
+		in.get(m.overshoot);
+		in.get(m.riseTime);
+		in.get(m.settlingTime);
+		in.get(m.started);
+		in.get(m.startTime);
+		getVec2(in, m.start);
+		getVec2(in, m.target);
+		getVec2(in, m.direction);
+		in.get(m.initialDistance);
+		in.get(m.riseStart);
+		in.get(m.settledSince);
+		getVec2(in, m.lastTarget);
+	}
+
+	inline void putIntegrator(std::vector<uint8_t> &out, const Integrator &integrator) {
+		putEnum(out, integrator.kind);
+		put(out, integrator.tolerance);
+		put(out, integrator.substep);
+		put(out, integrator.substeps);
+	}
+
+	inline void getIntegrator(Reader &in, Integrator &integrator) {
+		in.getEnum(integrator.kind, Integrator::DISCRETE, Integrator::DORMAND_PRINCE);
+		in.get(integrator.tolerance);
+		in.get(integrator.substep);
+		in.get(integrator.substeps);
+		// Dormand-Prince divides by the tolerance and starts from the substep
+		if (!(integrator.tolerance > 0) || !(integrator.substep >= 0) || !std::isfinite(integrator.substep)) in.ok = false;
+	}
+	template<typename T>
+	void putPID(std::vector<uint8_t> &out, const PIDControllerT<T> &pid) {
+		put(out, pid.p);
+		put(out, pid.i);
+		put(out, pid.d);
+		put(out, pid.integral);
+		put(out, pid.lastError);
+	}
+
+	template<typename T>
+	void getPID(Reader &in, PIDControllerT<T> &pid) {
+		in.get(pid.p);
+		in.get(pid.i);
+		in.get(pid.d);
+		in.get(pid.integral);
+		in.get(pid.lastError);
+	}
+
+	inline void putNoise(std::vector<uint8_t> &out, const SensorNoise &noise) {
+		putEnum(out, noise.kind);
+		put(out, noise.sigma);
+		put(out, noise.driftRate);
+		put(out, noise.streams.s0);
+		put(out, noise.streams.s1);
+		put(out, noise.streams.s2);
+		put(out, noise.streams.s3);
+		put(out, noise.streams.buffer);
+		put(out, noise.streams.buffered);
+		put(out, noise.fallback.state);
+		put(out, noise.fallback.inc);
+		put(out, (uint32_t)noise.channels());
+		for (size_t c = 0; c < noise.channels(); c++) {
+			put(out, noise.pink0[c]);
+			put(out, noise.pink1[c]);
+			put(out, noise.pink2[c]);
+			put(out, noise.bias[c]);
+		}
+	}
+
+	// Fails the read if the channel count doesn't match noise's
+	inline void getNoise(Reader &in, SensorNoise &noise) {
+		in.getEnum(noise.kind, SensorNoise::NONE, SensorNoise::DRIFT);
+		in.get(noise.sigma);
+		in.get(noise.driftRate);
+		in.get(noise.streams.s0);
+		in.get(noise.streams.s1);
+		in.get(noise.streams.s2);
+		in.get(noise.streams.s3);
+		in.get(noise.streams.buffer);
+		in.get(noise.streams.buffered);
+		// next() reads the last buffered words of buffer
+		if (noise.streams.buffered > (uint32_t)noise::Streams::STREAMS) in.ok = false;
+		in.get(noise.fallback.state);
+		in.get(noise.fallback.inc);
+		uint32_t channels = 0;
+		in.get(channels);
+		if (channels != noise.channels()) {
+			in.ok = false;
+			return;
+		}
+		for (size_t c = 0; c < channels; c++) {
+			in.get(noise.pink0[c]);
+			in.get(noise.pink1[c]);
+			in.get(noise.pink2[c]);
+			in.get(noise.bias[c]);
+		}
+	}
+
+	inline void putMultiRate(std::vector<uint8_t> &out, const MultiRateState &m) {
+		put(out, m.rates.sensorPeriod);
+		put(out, m.rates.controlPeriod);
+		put(out, m.rates.physicsPeriod);
+		put(out, (int32_t)m.rates.sensorDelay);
+		put(out, m.periods);
+		put(out, m.scheduler.now);
+		put(out, m.scheduler.periods);
+		for (const auto &event : m.scheduler.events) {
+			put(out, event.time);
+			put(out, (int32_t)event.stage);
+		}
+		for (const MultiRateState::SensorFrame &frame : m.readings.values) put(out, frame.values);
+		put(out, m.readings.head);
+		put(out, m.clock);
+	}
+
+	// Fails the read on a delay, delay line position, stage or period the
+	// stepping code couldn't use
+	inline void getMultiRate(Reader &in, MultiRateState &m) {
+		int32_t delay = 0;
+		in.get(m.rates.sensorPeriod);
+		in.get(m.rates.controlPeriod);
+		in.get(m.rates.physicsPeriod);
+		in.get(delay);
+		m.rates.sensorDelay = delay;
+		in.get(m.periods);
+		in.get(m.scheduler.now);
+		in.get(m.scheduler.periods);
+		for (auto &event : m.scheduler.events) {
+			int32_t stage = 0;
+			in.get(event.time);
+			in.get(stage);
+			event.stage = stage;
+		}
+		for (MultiRateState::SensorFrame &frame : m.readings.values) in.get(frame.values);
+		in.get(m.readings.head);
+		in.get(m.clock);
+		if (!in.ok) return;
+
+		const uint32_t lineLength = StageRates::MAX_SENSOR_DELAY + 1;
+		if (delay < 0 || delay > StageRates::MAX_SENSOR_DELAY || m.readings.head >= lineLength) in.ok = false;
+		// the scheduler only runs with stage rates set, which always resets it
+		if (m.rates.multiRate()) {
+			for (float period : m.periods) {
+				if (!(period > 0) || !std::isfinite(period)) in.ok = false;
+			}
+			if (!m.scheduler.valid() || m.scheduler.now != m.clock) in.ok = false;
+		}
+	}
+}
+
+// Appends sim's state to out (clear it first to reuse the buffer)
+inline void saveState(const Simulation &sim, std::vector<uint8_t> &out) {
+	using namespace simstate;
+	put(out, SIM_STATE_MAGIC);
+	put(out, SIM_STATE_VERSION);
+	put(out, SIM_STATE_SCALAR);
+	put(out, (uint8_t)sizeof(sim_real));
+
+	const AgentT<sim_real> &agent = sim.agent;
+	put(out, agent.pos.x);
+	put(out, agent.pos.y);
+	put(out, agent.vel.x);
+	put(out, agent.vel.y);
+	putPID(out, agent.xPID);
+	putPID(out, agent.yPID);
+	for (int i = 0; i < 4; i++) put(out, agent.sensorValues[i]);
+	put(out, agent.errorX);
+	put(out, agent.errorY);
+	put(out, agent.sensorOffset);
+
+	put(out, sim.time);
+	put(out, sim.steps);
+	put(out, sim.lastDT);
+	put(out, sim.target.x);
+	put(out, sim.target.y);
+	put(out, sim.rng.state);
+	put(out, sim.rng.inc);
+	putMetrics(out, sim.metrics);
+	putIntegrator(out, sim.integrator);
+	putNoise(out, sim.noise);
+	putMultiRate(out, sim.multiRate);
+}
+
+// Restores a state written by saveState. Leaves sim untouched and returns
+// false if the data is truncated, corrupt or from an incompatible build
+inline bool loadState(Simulation &sim, const uint8_t* data, size_t size) {
+	using namespace simstate;
+	Reader in = {data, size};
+	uint32_t magic = 0;
+	uint16_t version = 0;
+	uint8_t scalar = 0, scalarSize = 0;
+	in.get(magic);
+	in.get(version);
+	in.get(scalar);
+	in.get(scalarSize);
+	if (!in.ok || magic != SIM_STATE_MAGIC || version != SIM_STATE_VERSION
+		|| scalar != SIM_STATE_SCALAR || scalarSize != sizeof(sim_real)) {
+		return false;
+	}
+
+	Simulation loaded = sim;
+	AgentT<sim_real> &agent = loaded.agent;
+	in.get(agent.pos.x);
+	in.get(agent.pos.y);
+	in.get(agent.vel.x);
+	in.get(agent.vel.y);
+	getPID(in, agent.xPID);
+	getPID(in, agent.yPID);
+	for (int i = 0; i < 4; i++) in.get(agent.sensorValues[i]);
+	in.get(agent.errorX);
+	in.get(agent.errorY);
+	in.get(agent.sensorOffset);
+
+	in.get(loaded.time);
+	in.get(loaded.steps);
+	in.get(loaded.lastDT);
+	in.get(loaded.target.x);
+	in.get(loaded.target.y);
+	in.get(loaded.rng.state);
+	in.get(loaded.rng.inc);
+	getMetrics(in, loaded.metrics);
+	getIntegrator(in, loaded.integrator);
+	getNoise(in, loaded.noise);
+	getMultiRate(in, loaded.multiRate);
+	if (!in.ok || in.offset != size) return false;
+
+	sim = loaded;
+	return true;
+}
+
+inline bool loadState(Simulation &sim, const std::vector<uint8_t> &state) {
+	return loadState(sim, state.data(), state.size());
+}
+
+inline bool writeStateFile(const std::string &path, const std::vector<uint8_t> &state) {
+	FILE* file = fopen(path.c_str(), "wb");
+	if (!file) return false;
+	bool ok = fwrite(state.data(), 1, state.size(), file) == state.size();
+	return fclose(file) == 0 && ok;
+}
+
+inline bool readStateFile(const std::string &path, std::vector<uint8_t> &state) {
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file) return false;
+	state.clear();
+	uint8_t buffer[256];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		state.insert(state.end(), buffer, buffer + n);
+	}
+	fclose(file);
+	return true;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <thread>
+
+#include "alloc_count.h"
+#include "batch.h"
+#include "simulation.h"
+#include "triple_buffer.h"
+
+// agents extra agents on a grid over the 1080x720 window
+inline std::unique_ptr<AgentBatch> makeCrowd(int agents) {
+	std::unique_ptr<AgentBatch> batch(new AgentBatch(agents));
+	int columns = std::max(1, (int)ceil(sqrt(agents * 1080.0 / 720.0)));
+	int rows = (agents + columns - 1) / columns;
+	for (int a = 0; a < agents; a++) {
+		batch->setPosition(a, Vec2(1080.0f * (a % columns + 0.5f) / columns, 720.0f * (a / columns + 0.5f) / rows));
+	}
+	return batch;
+}
+
+// Copies the crowd's agents into snap, or empties its crowd without one
+inline void writeCrowdSnapshot(const AgentBatch* crowd, SimSnapshot &snap) {
+	size_t agents = crowd ? crowd->size() : 0;
+	snap.crowdPos.resize(agents);
+	snap.crowdVel.resize(agents);
+	snap.crowdSensorOffset.resize(agents);
+	for (size_t a = 0; a < agents; a++) {
+		snap.crowdPos[a] = crowd->position(a);
+		snap.crowdVel[a] = crowd->velocity(a);
+		snap.crowdSensorOffset[a] = crowd->sensorOffset(a);
+	}
+	snap.crowdAwake = crowd ? crowd->awakeCount() : 0;
+}
+
+// Runs a Simulation on its own thread at a fixed rate, along with any crowd
+// (SimInputs::crowdAgents) chasing its target, stepped in lockstep with it.
+// The UI thread writes SimInputs and reads SimSnapshots through triple
+// buffers, so rendering, vsync or a slow present never delays a control step.
+class SimulationThread {
+	public:
+	TripleBuffer<SimInputs> inputs;
+	TripleBuffer<SimSnapshot> snapshots;
+
+	// Control period in seconds
+	float dT;
+
+	SimulationThread(float dT = SIM_DT) : dT(dT) {
+		SimInputs initialInputs;
+		initialInputs.target = Vec2(1080, 720) / 2;
+		inputs.reset(initialInputs);
+		SimSnapshot initialSnapshot;
+		sim.writeSnapshot(initialSnapshot);
+		snapshots.reset(initialSnapshot);
+	}
+
+	~SimulationThread() {
+		stop();
+	}
+
+	void start() {
+		running = true;
+		thread = std::thread(&SimulationThread::run, this);
+	}
+
+	void stop() {
+		running = false;
+		if (thread.joinable()) thread.join();
+	}
+
+	private:
+	Simulation sim;
+	std::unique_ptr<AgentBatch> crowd;
+	uint64_t crowdVersion = 0; // bumped whenever the crowd changes
+	std::thread thread;
+	std::atomic<bool> running{false};
+
+	void run() {
+		alloccount::nameThread("simulation");
+		using clock = std::chrono::steady_clock;
+		auto period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<float>(dT));
+		auto nextStep = clock::now();
+
+		while (running) {
+			inputs.update();
+			const SimInputs &in = inputs.read();
+			{
+				AllocScope scope("physics step");
+				sim.setGains(in.gains);
+				sim.step(in.target, dT);
+			}
+			stepCrowd(in.crowdAgents);
+
+			SimSnapshot &snap = snapshots.writeSlot();
+			sim.writeSnapshot(snap);
+			if (snap.crowdVersion != crowdVersion) {
+				writeCrowdSnapshot(crowd.get(), snap);
+				snap.crowdVersion = crowdVersion;
+			}
+			snapshots.publish();
+
+			// Sleep to the next tick. If we fell behind (e.g. the machine was
+			// suspended) resync instead of bursting to catch up
+			nextStep += period;
+			auto now = clock::now();
+			if (nextStep < now - period * 4) {
+				nextStep = now;
+			}
+			std::this_thread::sleep_until(nextStep);
+		}
+	}
+
+	// Brings in, resizes or drops the crowd, then steps it to the
+	// simulation's time. A crowd that is all asleep doesn't change
+	void stepCrowd(int agents) {
+		if (agents != (crowd ? (int)crowd->size() : 0)) {
+			AllocScope scope("crowd");
+			crowd = agents > 0 ? makeCrowd(agents) : nullptr;
+			crowdVersion++;
+		}
+		if (!crowd) return;
+		AllocScope scope("crowd step");
+		crowd->setTarget(sim.target);
+		if (crowd->awakeCount() == 0) return;
+		crowd->step(dT);
+		crowdVersion++;
+	}
+};
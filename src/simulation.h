@@ -0,0 +1,243 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "physics.h"
+#include "rng.h"
+#include "metrics.h"
+#include "integrators.h"
+#include "noise.h"
+#include "scheduler.h"
+
+// Fixed control period in seconds
+const float SIM_DT = 1.0f / 120.0f;
+
+// PID gains, shared by the x and y controllers
+struct PIDGains {
+	float p = 0.25f;
+	float i = 0.1f;
+	float d = 0.1f;
+};
+
+// What the UI feeds the simulation each frame
+struct SimInputs {
+	Vec2 target;
+	PIDGains gains;
+	int crowdAgents = 0; // extra agents chasing the same target, 0 for none
+};
+
+// Everything the renderer needs to draw one simulation state, in plain floats
+struct SimSnapshot {
+	Vec2 target;
+	Vec2 pos;
+	Vec2 vel;
+	float sensorOffset = 20;
+	float errorX = 0, errorY = 0;
+	float integralX = 0, integralY = 0;
+	float lastErrorX = 0, lastErrorY = 0;
+	PIDGains gains;
+	float dT = 1;
+	double time = 0;
+	uint64_t steps = 0;
+
+	// The crowd, one entry per agent, empty without one. crowdVersion says
+	// which crowd state they hold, so an unchanged crowd isn't copied again
+	std::vector<Vec2> crowdPos, crowdVel;
+	std::vector<float> crowdSensorOffset;
+	size_t crowdAwake = 0;
+	uint64_t crowdVersion = 0;
+};
+
+// Separate periods for sampling the sensors, running the controllers and
+// moving the agent, plus a sensor latency in whole samples. A period of 0
+// means SIM_DT. All zero (the default) is the single rate stepAgent loop
+struct StageRates {
+	static const int MAX_SENSOR_DELAY = 15;
+
+	float sensorPeriod = 0;
+	float controlPeriod = 0;
+	float physicsPeriod = 0;
+	int sensorDelay = 0; // 0 to MAX_SENSOR_DELAY
+
+	bool multiRate() const {
+		return sensorPeriod > 0 || controlPeriod > 0 || physicsPeriod > 0 || sensorDelay > 0;
+	}
+};
+
+// Multi-rate stepping state: the stage scheduler and the sensor delay line.
+// Stages due at the same instant run in this order, which with equal periods
+// and no delay reproduces stepAgent exactly
+struct MultiRateState {
+	enum Stage { CONTROL, PHYSICS, SENSORS, STAGES };
+
+	struct SensorFrame {
+		sim_real values[4];
+	};
+
+	StageRates rates;
+	float periods[STAGES] = {SIM_DT, SIM_DT, SIM_DT}; // seconds, as the stages see them
+	MultiRateScheduler<STAGES> scheduler;
+	DelayLine<SensorFrame, StageRates::MAX_SENSOR_DELAY + 1> readings;
+	uint64_t clock = 0; // ns, advanced by each step's dT
+};
+
+// The simulated world: one sensor array chasing a target.
+// Plain data, so copying a Simulation forks it (see sim_state.h to serialise)
+class Simulation {
+	public:
+	AgentT<sim_real> agent;
+	double time = 0;
+	uint64_t steps = 0;
+	float lastDT = 1;
+	Vec2 target;
+	Rng rng;
+	RunMetrics metrics;
+	Vec2 lastControl; // controller output of the last step, not part of the saved state
+	Integrator integrator;
+	SensorNoise noise; // added to the four sensor readings, none by default
+	MultiRateState multiRate;
+
+	Simulation() {
+		agent.pos = Vec2T<sim_real>(1080/2, 720/2);
+		noise.resize(4);
+	}
+
+	void setGains(const PIDGains &gains) {
+		agent.xPID.p = agent.yPID.p = gains.p;
+		agent.xPID.i = agent.yPID.i = gains.i;
+		agent.xPID.d = agent.yPID.d = gains.d;
+	}
+
+	// Switches between single rate stepping and separate stage rates. Stages
+	// restart from now, and the delay line is primed with the current readings
+	void setRates(const StageRates &rates) {
+		MultiRateState &m = multiRate;
+		m.rates = rates;
+		m.rates.sensorDelay = std::min(std::max(rates.sensorDelay, 0), (int)StageRates::MAX_SENSOR_DELAY);
+		m.periods[MultiRateState::SENSORS] = rates.sensorPeriod > 0 ? rates.sensorPeriod : SIM_DT;
+		m.periods[MultiRateState::CONTROL] = rates.controlPeriod > 0 ? rates.controlPeriod : SIM_DT;
+		m.periods[MultiRateState::PHYSICS] = rates.physicsPeriod > 0 ? rates.physicsPeriod : SIM_DT;
+		uint64_t periods[MultiRateState::STAGES];
+		for (int s = 0; s < MultiRateState::STAGES; s++) periods[s] = (uint64_t)llround(m.periods[s] * 1e9);
+		m.scheduler.now = m.clock;
+		m.scheduler.reset(periods);
+		MultiRateState::SensorFrame frame;
+		for (int s = 0; s < 4; s++) frame.values[s] = agent.sensorValues[s];
+		m.readings.reset(frame);
+	}
+
+	void step(const Vec2 &newTarget, float dT) {
+		target = newTarget;
+		if (multiRate.rates.multiRate() && integrator.kind == Integrator::DISCRETE) {
+			lastControl = stepMultiRate(dT);
+		} else {
+			float sensorNoise[4];
+			const float* noisy = sampleNoise(sensorNoise, dT);
+			if (integrator.kind == Integrator::DISCRETE) {
+				Vec2T<sim_real> control = stepAgent(agent, Vec2T<sim_real>(target.x, target.y), sim_real(dT), noisy);
+				lastControl = Vec2((float)control.x, (float)control.y);
+			} else {
+				lastControl = stepContinuous(dT, noisy);
+			}
+		}
+		time += dT;
+		metrics.update(time, target, Vec2((float)agent.pos.x, (float)agent.pos.y), lastControl, dT);
+		lastDT = dT;
+		steps++;
+	}
+
+	// Fills out with the next four noise samples, or returns nullptr without noise
+	const float* sampleNoise(float out[4], float dT) {
+		if (noise.kind == SensorNoise::NONE) return nullptr;
+		noise.fill(out, dT);
+		return out;
+	}
+
+	// Runs whichever stages fall due within the next dT, each with its own
+	// period. Returns the total control applied
+	Vec2 stepMultiRate(float dT) {
+		MultiRateState &m = multiRate;
+		Vec2T<sim_real> targetAt(target.x, target.y);
+		Vec2 applied;
+		m.clock += (uint64_t)llround(dT * 1e9);
+		m.scheduler.advance(m.clock, [&](int stage, uint64_t) {
+			sim_real period = sim_real(m.periods[stage]);
+			switch (stage) {
+				case MultiRateState::CONTROL: {
+					Vec2T<sim_real> control = applyControl(agent, period);
+					applied += Vec2((float)control.x, (float)control.y);
+					break;
+				}
+				case MultiRateState::PHYSICS:
+					moveAgent(agent, period);
+					break;
+				case MultiRateState::SENSORS: {
+					float sensorNoise[4];
+					readSensors(agent, targetAt, sampleNoise(sensorNoise, m.periods[stage]));
+					// the controllers see the reading from sensorDelay samples ago
+					MultiRateState::SensorFrame frame;
+					for (int s = 0; s < 4; s++) frame.values[s] = agent.sensorValues[s];
+					m.readings.push(frame);
+					const MultiRateState::SensorFrame &seen = m.readings.delayed(m.rates.sensorDelay);
+					for (int s = 0; s < 4; s++) agent.sensorValues[s] = seen.values[s];
+					updateErrors(agent);
+					break;
+				}
+			}
+		});
+		return applied;
+	}
+
+	// Integrates the continuous model (integrators.h) over dT. The x gains are
+	// used for both axes, as setGains keeps them equal, and stage rates don't
+	// apply. The model itself sees exact sensors; sensorNoise only goes into
+	// the readings left for the sampled controller
+	Vec2 stepContinuous(float dT, const float* sensorNoise = nullptr) {
+		AgentDynamics dynamics;
+		dynamics.target = target;
+		dynamics.p = (float)agent.xPID.p;
+		dynamics.i = (float)agent.xPID.i;
+		dynamics.d = (float)agent.xPID.d;
+		dynamics.sensorOffset = (float)agent.sensorOffset;
+		dynamics.controlPeriod = SIM_DT;
+		
+		AgentState state;
+		state.pos = Vec2((float)agent.pos.x, (float)agent.pos.y);
+		state.vel = Vec2((float)agent.vel.x, (float)agent.vel.y);
+		state.integral = Vec2((float)agent.xPID.integral, (float)agent.yPID.integral);
+		Vec2 startVel = state.vel;
+		integrator.advance(dynamics, state, dT);
+		
+		agent.pos = Vec2T<sim_real>(state.pos.x, state.pos.y);
+		agent.vel = Vec2T<sim_real>(state.vel.x, state.vel.y);
+		agent.xPID.integral = state.integral.x;
+		agent.yPID.integral = state.integral.y;
+		// keep the sampled controller consistent in case the integrator is switched back
+		agent.xPID.lastError = agent.errorX;
+		agent.yPID.lastError = agent.errorY;
+		readSensors(agent, Vec2T<sim_real>(target.x, target.y), sensorNoise);
+		return state.vel - startVel;
+	}
+
+	void writeSnapshot(SimSnapshot &snap) const {
+		snap.target = target;
+		snap.pos = Vec2((float)agent.pos.x, (float)agent.pos.y);
+		snap.vel = Vec2((float)agent.vel.x, (float)agent.vel.y);
+		snap.sensorOffset = (float)agent.sensorOffset;
+		snap.errorX = (float)agent.errorX;
+		snap.errorY = (float)agent.errorY;
+		snap.integralX = (float)agent.xPID.integral;
+		snap.integralY = (float)agent.yPID.integral;
+		snap.lastErrorX = (float)agent.xPID.lastError;
+		snap.lastErrorY = (float)agent.yPID.lastError;
+		snap.gains.p = (float)agent.xPID.p;
+		snap.gains.i = (float)agent.xPID.i;
+		snap.gains.d = (float)agent.xPID.d;
+		snap.dT = lastDT;
+		snap.time = time;
+		snap.steps = steps;
+	}
+};
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "fft.h"
+
+// Welch estimate of the auto spectra of two signals and their cross spectrum:
+// Hann windowed segments with 50% overlap, mean removed per segment, one
+// sided and scaled to power per Hz. Both real signals go through a single
+// complex FFT per segment (x in the real part, y in the imaginary part).
+struct CrossSpectrum {
+	float sampleRate = 0;
+	int segmentLength = 0;
+	int segments = 0;
+	std::vector<float> frequency;
+	std::vector<double> pxx, pyy;     // auto spectra
+	std::vector<double> pxyRe, pxyIm; // cross spectrum conj(X) Y
+
+	size_t bins() const {
+		return frequency.size();
+	}
+
+	// Transfer function estimate H1 = Pxy / Pxx from x to y
+	double gain(size_t k) const {
+		return pxx[k] > 0 ? sqrt(pxyRe[k] * pxyRe[k] + pxyIm[k] * pxyIm[k]) / pxx[k] : 0;
+	}
+
+	double phase(size_t k) const {
+		return atan2(pxyIm[k], pxyRe[k]);
+	}
+
+	// 1 where y is fully explained by x linearly, 0 where unrelated
+	double coherence(size_t k) const {
+		double denominator = pxx[k] * pyy[k];
+		return denominator > 0 ? (pxyRe[k] * pxyRe[k] + pxyIm[k] * pxyIm[k]) / denominator : 0;
+	}
+};
+
+// segmentLength must be a power of two; signals shorter than one segment give no segments
+inline CrossSpectrum welch(const float* x, const float* y, size_t n, float sampleRate, int segmentLength) {
+	CrossSpectrum s;
+	s.sampleRate = sampleRate;
+	s.segmentLength = segmentLength;
+	size_t bins = segmentLength / 2 + 1;
+	s.frequency.resize(bins);
+	for (size_t k = 0; k < bins; k++) s.frequency[k] = k * sampleRate / segmentLength;
+	s.pxx.assign(bins, 0);
+	s.pyy.assign(bins, 0);
+	s.pxyRe.assign(bins, 0);
+	s.pxyIm.assign(bins, 0);
+
+	std::vector<float> window(segmentLength);
+	double windowPower = 0;
+	for (int i = 0; i < segmentLength; i++) {
+		window[i] = 0.5f - 0.5f * (float)cos(2 * M_PI * i / segmentLength);
+		windowPower += window[i] * window[i];
+	}
+
+	FFT fft(segmentLength);
+	std::vector<float> re(segmentLength), im(segmentLength);
+	size_t hop = segmentLength / 2;
+	for (size_t start = 0; start + segmentLength <= n; start += hop) {
+		double meanX = 0, meanY = 0;
+		for (int i = 0; i < segmentLength; i++) {
+			meanX += x[start + i];
+			meanY += y[start + i];
+		}
+		meanX /= segmentLength;
+		meanY /= segmentLength;
+		for (int i = 0; i < segmentLength; i++) {
+			re[i] = (float)(x[start + i] - meanX) * window[i];
+			im[i] = (float)(y[start + i] - meanY) * window[i];
+		}
+		fft.forward(re.data(), im.data());
+
+		// Separate the two real spectra: X = (Z[k] + conj Z[n-k]) / 2, Y = (Z[k] - conj Z[n-k]) / 2i
+		for (size_t k = 0; k < bins; k++) {
+			size_t m = (segmentLength - k) % segmentLength;
+			double xr = 0.5 * (re[k] + re[m]), xi = 0.5 * (im[k] - im[m]);
+			double yr = 0.5 * (im[k] + im[m]), yi = -0.5 * (re[k] - re[m]);
+			s.pxx[k] += xr * xr + xi * xi;
+			s.pyy[k] += yr * yr + yi * yi;
+			s.pxyRe[k] += xr * yr + xi * yi;
+			s.pxyIm[k] += xr * yi - xi * yr;
+		}
+		s.segments++;
+	}
+
+	if (s.segments == 0) return s;
+	for (size_t k = 0; k < bins; k++) {
+		// one sided: double everything but DC and Nyquist
+		double scale = (k == 0 || k == bins - 1 ? 1.0 : 2.0) / (sampleRate * windowPower * s.segments);
+		s.pxx[k] *= scale;
+		s.pyy[k] *= scale;
+		s.pxyRe[k] *= scale;
+		s.pxyIm[k] *= scale;
+	}
+	return s;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+
+#include "simulation.h"
+
+// Linearised, discretised model of one axis of the closed loop near the
+// target, for screening gain candidates without simulating them.
+//
+// Near the target the sensor error is proportional to the position error,
+// e = -K p (target at 0), with K from the slope of the sensor model at the
+// sensor offset, and the controller output scale s clamps to 1. One step of
+// stepAgent at period dT is then linear:
+//
+//     u[k+1] = P e[k] + I (integral[k] + e[k] dT) + D (e[k] - e[k-1]) / dT
+//     v[k+1] = v[k] + s u[k+1],  p[k+1] = p[k] + v[k+1] dT
+//
+// Differencing away v and the integral leaves a third order recurrence in p
+// with characteristic polynomial (q = dT s K)
+//
+//     (z - 1)^3 + q ((P + I dT + D/dT) z^2 - (P + 2 D/dT) z + D/dT)
+//
+// The loop is stable iff its roots lie inside the unit circle, which
+// isStable() decides with the Jury (Schur-Cohn) test in a few dozen flops.
+// With no integral gain the polynomial has a harmless root at exactly 1
+// (there is no integral state to feed back), which is divided out first.
+
+// Slope of the sensor error with respect to position error at the target
+inline double sensorGain(double sensorOffset) {
+	double u = sensorOffset * sensorOffset + 100;
+	return 800.0 * sensorOffset * 100.0 / (u * u);
+}
+
+struct LinearModel {
+	double characteristic[4]; // z^n + c[1] z^(n-1) + ... + c[n], leading coefficient first
+	int degree = 3;
+
+	LinearModel(const PIDGains &gains, double dT, double sensorOffset = 20, double scale = 1) {
+		double q = dT * scale * sensorGain(sensorOffset);
+		characteristic[0] = 1;
+		characteristic[1] = -3 + q * (gains.p + gains.i * dT + gains.d / dT);
+		characteristic[2] = 3 - q * (gains.p + 2 * gains.d / dT);
+		characteristic[3] = -1 + q * gains.d / dT;
+		if (gains.i == 0) {
+			// synthetic division by (z - 1)
+			for (int k = 1; k < 3; k++) characteristic[k] += characteristic[k - 1];
+			degree = 2;
+		}
+	}
+
+	// Jury / Schur-Cohn: all roots of the characteristic polynomial strictly inside the unit circle
+	bool isStable() const {
+		double a[4];
+		for (int i = 0; i <= degree; i++) a[i] = characteristic[i];
+		for (int n = degree; n > 0; n--) {
+			if (fabs(a[n]) >= fabs(a[0])) return false;
+			// (a0 p(z) - an p*(z)) / z keeps the roots inside iff p's were
+			double reduced[4];
+			for (int k = 0; k < n; k++) reduced[k] = a[0] * a[k] - a[n] * a[n - k];
+			for (int k = 0; k < n; k++) a[k] = reduced[k];
+		}
+		return true;
+	}
+
+	// Largest closed loop pole magnitude (Durand-Kerner). Below 1 is stable; the
+	// closer to 0 the faster disturbances decay. Slower than isStable()
+	double spectralRadius() const {
+		std::complex<double> roots[3];
+		std::complex<double> seed(0.4, 0.9);
+		for (int i = 0; i < degree; i++) roots[i] = std::pow(seed, i);
+		for (int iteration = 0; iteration < 200; iteration++) {
+			double change = 0;
+			for (int i = 0; i < degree; i++) {
+				std::complex<double> value = 1;
+				for (int k = 1; k <= degree; k++) value = value * roots[i] + characteristic[k];
+				std::complex<double> denominator = 1;
+				for (int j = 0; j < degree; j++) {
+					if (j != i) denominator *= roots[i] - roots[j];
+				}
+				std::complex<double> delta = value / denominator;
+				roots[i] -= delta;
+				change = std::max(change, std::abs(delta));
+			}
+			if (change < 1e-12) break;
+		}
+		double radius = 0;
+		for (int i = 0; i < degree; i++) radius = std::max(radius, std::abs(roots[i]));
+		return radius;
+	}
+};
+
+// Shorthand for sweeps and tuners: can these gains hold the target at this period?
+inline bool isStable(const PIDGains &gains, float dT = SIM_DT) {
+	return LinearModel(gains, dT).isStable();
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <SDL.h>
+
+// Part of the scene that doesn't change between frames (the grid, fixed
+// labels, axes). It's drawn once into a transparent target texture the size
+// of the output and blitted every frame after that, until the output size
+// changes or invalidate() is called. Renderers without target textures get
+// the layer drawn directly every frame instead.
+class StaticLayer {
+	public:
+	typedef void (*DrawFunction)(SDL_Renderer* renderer);
+
+	// How many times the layer has been drawn into its texture
+	unsigned redraws = 0;
+
+	explicit StaticLayer(DrawFunction draw) : draw(draw) {}
+
+	StaticLayer(const StaticLayer&) = delete;
+	StaticLayer& operator=(const StaticLayer&) = delete;
+
+	~StaticLayer() {
+		release();
+	}
+
+	// Redraws the layer on its next render
+	void invalidate() {
+		dirty = true;
+	}
+
+	// Frees the texture, which must happen before its renderer is destroyed
+	void release() {
+		if (texture) SDL_DestroyTexture(texture);
+		texture = nullptr;
+		dirty = true;
+	}
+
+	void render(SDL_Renderer* renderer) {
+		int w, h;
+		SDL_GetRendererOutputSize(renderer, &w, &h);
+		if (w != width || h != height) {
+			release();
+			width = w;
+			height = h;
+			unsupported = false;
+		}
+		if (dirty && !unsupported) redraw(renderer);
+		if (unsupported) {
+			draw(renderer);
+			return;
+		}
+		SDL_RenderCopy(renderer, texture, NULL, NULL);
+	}
+
+	private:
+	DrawFunction draw;
+	SDL_Texture* texture = nullptr;
+	int width = 0, height = 0;
+	bool dirty = true;
+	bool unsupported = false; // no target textures on this renderer
+
+	void redraw(SDL_Renderer* renderer) {
+		if (!texture) {
+			texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, width, height);
+			if (!texture) {
+				unsupported = true;
+				return;
+			}
+			SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+		}
+		SDL_Texture* previous = SDL_GetRenderTarget(renderer);
+		if (SDL_SetRenderTarget(renderer, texture) < 0) {
+			release();
+			unsupported = true;
+			return;
+		}
+		SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+		SDL_RenderClear(renderer);
+		draw(renderer);
+		SDL_SetRenderTarget(renderer, previous);
+		dirty = false;
+		redraws++;
+	}
+};
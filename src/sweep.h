@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+
+#include "alloc_count.h"
+#include "arena.h"
+#include "simulation.h"
+
+// One candidate in a sweep: gains and a step to run them on
+struct SweepCase {
+	PIDGains gains;
+	Vec2 start = Vec2(1080/2, 720/2);
+	Vec2 target = Vec2(300, 200);
+	int steps = 600;
+	float dT = SIM_DT;
+};
+
+// Everything one run needs, carved out of its worker's arena
+struct SweepRun {
+	AgentT<sim_real>* agent = nullptr;
+	RunMetrics* metrics = nullptr;
+	Vec2* trajectory = nullptr; // position after each step
+	int steps = 0;
+};
+
+// Runs sweep cases one after another, one worker per thread. Each run's state
+// comes from the worker's arena, reset between runs, so once the arena fits a
+// run the worker makes no heap allocations and never waits on malloc's locks.
+// Anything a caller wants per run (scratch space, extra buffers) can come from
+// arena too, before or after run()
+class SweepWorker {
+	public:
+	Arena arena;
+	uint64_t stepAllocations = 0; // heap allocations seen inside step loops, should stay 0
+
+	// The run (and anything else allocated from arena) lasts until the next call
+	const SweepRun& run(const SweepCase &c) {
+		arena.reset();
+		current.agent = arena.make<AgentT<sim_real>>();
+		current.metrics = arena.make<RunMetrics>();
+		current.trajectory = arena.makeArray<Vec2>(c.steps);
+		current.steps = c.steps;
+
+		AgentT<sim_real> &agent = *current.agent;
+		agent.pos = Vec2T<sim_real>(c.start.x, c.start.y);
+		agent.xPID.p = agent.yPID.p = c.gains.p;
+		agent.xPID.i = agent.yPID.i = c.gains.i;
+		agent.xPID.d = agent.yPID.d = c.gains.d;
+		Vec2T<sim_real> target(c.target.x, c.target.y);
+
+		NoAllocations noAllocations;
+		for (int step = 0; step < c.steps; step++) {
+			Vec2T<sim_real> control = stepAgent(agent, target, sim_real(c.dT));
+			Vec2 pos((float)agent.pos.x, (float)agent.pos.y);
+			current.trajectory[step] = pos;
+			current.metrics->update((step + 1) * (double)c.dT, c.target, pos, Vec2((float)control.x, (float)control.y), c.dT);
+		}
+		stepAllocations += noAllocations.count();
+		return current;
+	}
+
+	private:
+	SweepRun current;
+};
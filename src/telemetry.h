@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Per step record of a run, for offline analysis (see analyze.cpp).
+// error is what PIDController::update was fed that step, control what the
+// controllers output (scaled, i.e. the change in velocity). time is a double
+// so step times stay exact over runs of millions of samples
+struct TelemetrySample {
+	double time;
+	float targetX, targetY;
+	float posX, posY;
+	float errorX, errorY;
+	float controlX, controlY;
+};
+
+const uint32_t TELEMETRY_MAGIC = 0x54444950; // "PIDT"
+const uint32_t TELEMETRY_VERSION = 2;
+
+// Buffered binary writer: a small header then raw TelemetrySamples.
+// A failed write (a full disk) stops all further output and is reported by
+// failed() and error(), like FrameWriter
+class TelemetryWriter {
+	public:
+	~TelemetryWriter() {
+		close();
+	}
+
+	bool open(const std::string &path) {
+		file = fopen(path.c_str(), "wb");
+		if (!file) return false;
+		uint32_t header[3] = {TELEMETRY_MAGIC, TELEMETRY_VERSION, (uint32_t)sizeof(TelemetrySample)};
+		if (fwrite(header, sizeof(header), 1, file) != 1) fail();
+		buffer.reserve(BUFFER_SAMPLES);
+		return true;
+	}
+
+	void write(const TelemetrySample &sample) {
+		buffer.push_back(sample);
+		if (buffer.size() == BUFFER_SAMPLES) flush();
+	}
+
+	// Writes what is buffered and closes the file
+	void close() {
+		if (!file) return;
+		flush();
+		if (fclose(file) != 0) fail();
+		file = nullptr;
+	}
+
+	// Whether any write failed. Samples written since are dropped
+	bool failed() const {
+		return errorCode != 0;
+	}
+
+	// errno of the first failed write, or 0
+	int error() const {
+		return errorCode;
+	}
+
+	private:
+	static const size_t BUFFER_SAMPLES = 4096;
+	FILE* file = nullptr;
+	std::vector<TelemetrySample> buffer;
+	int errorCode = 0;
+
+	void flush() {
+		if (!failed() && fwrite(buffer.data(), sizeof(TelemetrySample), buffer.size(), file) != buffer.size()) {
+			fail();
+		}
+		buffer.clear();
+	}
+
+	// Keeps the first error. Short writes don't always set errno
+	void fail() {
+		if (!errorCode) errorCode = errno ? errno : EIO;
+	}
+};
+
+// Reads a whole telemetry file. Returns false if it is missing or not telemetry
+inline bool readTelemetry(const std::string &path, std::vector<TelemetrySample> &samples) {
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file) return false;
+	uint32_t header[3];
+	if (fread(header, sizeof(header), 1, file) != 1 || header[0] != TELEMETRY_MAGIC
+		|| header[1] != TELEMETRY_VERSION || header[2] != sizeof(TelemetrySample)) {
+		fclose(file);
+		return false;
+	}
+	fseek(file, 0, SEEK_END);
+	long bytes = ftell(file) - (long)sizeof(header);
+	fseek(file, sizeof(header), SEEK_SET);
+	samples.resize(bytes / sizeof(TelemetrySample));
+	size_t read = fread(samples.data(), sizeof(TelemetrySample), samples.size(), file);
+	samples.resize(read);
+	fclose(file);
+	return true;
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "heatmap.h"
+#include "vec2.h"
+
+// A tile's texels within its TiledHeatmap. Tiles on the right and bottom
+// edges are cut short to the heatmap's size
+struct TileRect {
+	int x, y, w, h;
+};
+
+// Heatmap of a field lit by any number of point lights, fixed in the world
+// and split into TILE x TILE texel tiles. Every tile keeps the lights whose
+// reach (params.maxDistance) overlaps it, so moving a light only dirties
+// the tiles under its old and new footprint, and update() recomputes just
+// those from just their own lights. Each recomputed tile is handed to an
+// upload callback, which for SDL is one SDL_UpdateTexture sub-rect:
+//
+//     TiledHeatmap field(params, origin, worldPerTexel, width, height);
+//     int light = field.addLight(pos);
+//     ...
+//     field.moveLight(light, newPos);
+//     field.update([&](const TileRect &tile, const uint32_t* pixels, int pitch) {
+//         SDL_Rect rect = {tile.x, tile.y, tile.w, tile.h};
+//         SDL_UpdateTexture(texture, &rect, pixels, pitch);
+//     });
+//
+// Texel (x, y) sits at origin + (x, y) * worldPerTexel, and lights add up
+// (see generateHeatmapRegion). Lit texels follow params.sampleStep over the
+// whole field, so tiles join up seamlessly. Upload rects never reach past
+// width() x height(), the size asked for, so a texture of that size fits.
+class TiledHeatmap {
+	public:
+	static constexpr int TILE = 64; // texels per tile side
+
+	// Tiles recomputed over the heatmap's lifetime
+	uint64_t tilesUpdated = 0;
+
+	// Covers width x height texels from origin, the world position of
+	// texel (0, 0)
+	TiledHeatmap(const HeatmapParams &params, const Vec2 &origin, float worldPerTexel, int width, int height)
+		: params(params), origin(origin), worldPerTexel(worldPerTexel), fieldWidth(width), fieldHeight(height),
+		tilesX((width + TILE - 1) / TILE), tilesY((height + TILE - 1) / TILE),
+		tiles((size_t)tilesX * tilesY), pixelBuffer((size_t)width * height, 0) {
+		// nothing lit yet, but the texture still needs clearing once
+		invalidate();
+	}
+
+	// Recomputes every tile on the next update(), e.g. after the texture was lost
+	void invalidate() {
+		for (int t = 0; t < (int)tiles.size(); t++) markDirty(t);
+	}
+
+	int width() const {
+		return fieldWidth;
+	}
+
+	int height() const {
+		return fieldHeight;
+	}
+
+	int tileCount() const {
+		return (int)tiles.size();
+	}
+
+	size_t dirtyCount() const {
+		return dirty.size();
+	}
+
+	// All texels, rows packed (pitch width() * 4 bytes)
+	const uint32_t* pixels() const {
+		return pixelBuffer.data();
+	}
+
+	int addLight(const Vec2 &pos) {
+		lights.push_back(pos);
+		int light = (int)lights.size() - 1;
+		forFootprint(pos, [&](int t) {
+			tiles[t].lights.push_back(light);
+			markDirty(t);
+		});
+		return light;
+	}
+
+	void moveLight(int light, const Vec2 &pos) {
+		if (lights[light].x == pos.x && lights[light].y == pos.y) return;
+		forFootprint(lights[light], [&](int t) {
+			std::vector<int> &affecting = tiles[t].lights;
+			affecting.erase(std::remove(affecting.begin(), affecting.end(), light), affecting.end());
+			markDirty(t);
+		});
+		lights[light] = pos;
+		forFootprint(pos, [&](int t) {
+			tiles[t].lights.push_back(light);
+			markDirty(t);
+		});
+	}
+
+	const Vec2& light(int light) const {
+		return lights[light];
+	}
+
+	// Recomputes every dirty tile, calling upload(rect, pixels, pitch) for
+	// each with its texel rect, its first texel and the row pitch in bytes
+	template<typename Upload>
+	void update(Upload upload) {
+		for (int t : dirty) {
+			Tile &tile = tiles[t];
+			tile.dirty = false;
+			int x0 = (t % tilesX) * TILE, y0 = (t / tilesX) * TILE;
+			TileRect rect{x0, y0, std::min(TILE, fieldWidth - x0), std::min(TILE, fieldHeight - y0)};
+			generateTile(tile, rect);
+			tilesUpdated++;
+			upload(rect, &pixelBuffer[(size_t)y0 * fieldWidth + x0], fieldWidth * (int)sizeof(uint32_t));
+		}
+		dirty.clear();
+	}
+
+	private:
+	struct Tile {
+		std::vector<int> lights; // indices of the lights that reach this tile
+		bool dirty = false;
+	};
+
+	HeatmapParams params;
+	Vec2 origin;
+	float worldPerTexel;
+	int fieldWidth, fieldHeight;
+	int tilesX, tilesY;
+	std::vector<Vec2> lights;
+	std::vector<Tile> tiles;
+	std::vector<int> dirty; // tiles to recompute, each listed once
+	std::vector<uint32_t> pixelBuffer;
+
+	void markDirty(int t) {
+		if (tiles[t].dirty) return;
+		tiles[t].dirty = true;
+		dirty.push_back(t);
+	}
+
+	// Calls f with every tile a light at pos can reach
+	template<typename F>
+	void forFootprint(const Vec2 &pos, F f) {
+		float reach = params.maxDistance / worldPerTexel;
+		Vec2 centre = (pos - origin) / worldPerTexel;
+		int x0 = std::max(0, (int)floorf((centre.x - reach) / TILE));
+		int x1 = std::min(tilesX - 1, (int)floorf((centre.x + reach) / TILE));
+		int y0 = std::max(0, (int)floorf((centre.y - reach) / TILE));
+		int y1 = std::min(tilesY - 1, (int)floorf((centre.y + reach) / TILE));
+		for (int ty = y0; ty <= y1; ty++) {
+			for (int tx = x0; tx <= x1; tx++) f(ty * tilesX + tx);
+		}
+	}
+
+	void generateTile(const Tile &tile, const TileRect &rect) {
+		generateHeatmapRegion(params, lights.data(), tile.lights.data(), (int)tile.lights.size(), origin, worldPerTexel,
+			rect.x, rect.y, rect.w, rect.h, &pixelBuffer[(size_t)rect.y * fieldWidth + rect.x], fieldWidth);
+	}
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single producer / single consumer triple buffer.
+// The writer fills the back slot and publishes it, the reader picks up the
+// newest published slot. Neither side ever waits on the other, so a stalled
+// reader (e.g. a slow present) can't hold the writer up, it just skips states.
+template<typename T>
+class TripleBuffer {
+	private:
+	// Bits 0-1: index of the middle slot, bit 2: middle slot holds unread data
+	static const uint8_t INDEX_MASK = 3;
+	static const uint8_t DIRTY = 4;
+
+	T slots[3];
+	std::atomic<uint8_t> middle{1};
+	uint8_t back = 0;  // only touched by the writer
+	uint8_t front = 2; // only touched by the reader
+
+	public:
+	// Sets every slot to a copy of initial so the reader never sees garbage.
+	// Only safe while neither side is running
+	void reset(const T& initial) {
+		slots[0] = slots[1] = slots[2] = initial;
+		middle.store(1);
+		back = 0;
+		front = 2;
+	}
+
+	// Writer side: slot to fill before publish()
+	T& writeSlot() {
+		return slots[back];
+	}
+
+	// Writer side: hands the back slot to the reader
+	void publish() {
+		back = middle.exchange(back | DIRTY, std::memory_order_acq_rel) & INDEX_MASK;
+	}
+
+	// Reader side: swaps in the newest published slot if there is one.
+	// Returns true if it changed
+	bool update() {
+		if (!(middle.load(std::memory_order_relaxed) & DIRTY)) return false;
+		front = middle.exchange(front, std::memory_order_acq_rel) & INDEX_MASK;
+		return true;
+	}
+
+	// Reader side: newest slot picked up by update()
+	const T& read() const {
+		return slots[front];
+	}
+};
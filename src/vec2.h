@@ -0,0 +1,65 @@
+#pragma once
+
+// Two component vector. Templated on the scalar so the same physics code can
+// run in float or in fixed point (see fixed.h)
+template<typename T>
+class Vec2T {
+	public: 
+	T x, y;
+	
+	Vec2T(T a = T(0), T b = T(0)) {
+		x = a;
+		y = b;
+	}
+	
+	// Operator overloads
+	// Scalar Vector product using operator*
+	Vec2T operator*(T other) const {
+		return Vec2T(x * other, y * other);
+	}
+	
+	// Dot product using operator*
+	T operator*(const Vec2T& other) const {
+		return (x * other.x) + (y * other.y);
+	}
+	
+	// Vec2 addition using operator+
+	Vec2T operator+(const Vec2T& other) const {
+		return Vec2T(x + other.x, y + other.y);
+	}
+	
+	// Vec2 += addition using operator+=
+	Vec2T& operator+=(const Vec2T& other) {
+		x += other.x;
+		y += other.y;
+		return *this;
+	}
+	
+	// Vec2 -= subtraction using operator-=
+	Vec2T& operator-=(const Vec2T& other) {
+		x -= other.x;
+		y -= other.y;
+		return *this;
+	}
+	
+	// Vec2 subtraction using operator-
+	Vec2T operator-(const Vec2T& other) const {
+		return Vec2T(x - other.x, y - other.y);
+	}
+	
+	// Vec2 unary subtraction using operator-
+	Vec2T operator-() const {
+		return Vec2T(-x, -y);
+	}
+	
+	// Scalar Vector quotient using operator/
+	Vec2T operator/(T other) const {
+		return Vec2T(x / other, y / other);
+	}
+	
+	T magnitude_squared() const {
+		return x*x + y*y;
+	}
+};
+
+typedef Vec2T<float> Vec2;
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#include "vec2.h"
+
+// Packs of N floats / Vec2s for running many agents at once.
+// Every operator is a fixed length loop over the lanes, which the compiler
+// turns into packed SSE/AVX instructions (build with -O2 or higher).
+// Agents are stored as an array of blocks, each block holding N agents
+// structure-of-arrays style (AoSoA), so a block fills whole vector registers.
+
+// Lane count used by the simulation. 8 fills an AVX register, 16 an AVX-512 one
+const int SIM_LANES = 8;
+
+// Per lane comparison result, all bits set for true
+template<int N>
+struct MaskN {
+	int32_t v[N];
+};
+
+template<int N>
+class FloatN {
+	public:
+	alignas(N * sizeof(float)) float v[N];
+
+	// Broadcasts a scalar to every lane
+	FloatN(float s = 0.0f) {
+		for (int i = 0; i < N; i++) v[i] = s;
+	}
+
+	static FloatN load(const float* src) {
+		FloatN r;
+		for (int i = 0; i < N; i++) r.v[i] = src[i];
+		return r;
+	}
+
+	void store(float* dst) const {
+		for (int i = 0; i < N; i++) dst[i] = v[i];
+	}
+
+	float& operator[](int i) { return v[i]; }
+	float operator[](int i) const { return v[i]; }
+
+	FloatN operator+(const FloatN& o) const { FloatN r; for (int i = 0; i < N; i++) r.v[i] = v[i] + o.v[i]; return r; }
+	FloatN operator-(const FloatN& o) const { FloatN r; for (int i = 0; i < N; i++) r.v[i] = v[i] - o.v[i]; return r; }
+	FloatN operator*(const FloatN& o) const { FloatN r; for (int i = 0; i < N; i++) r.v[i] = v[i] * o.v[i]; return r; }
+	FloatN operator/(const FloatN& o) const { FloatN r; for (int i = 0; i < N; i++) r.v[i] = v[i] / o.v[i]; return r; }
+	FloatN operator-() const { FloatN r; for (int i = 0; i < N; i++) r.v[i] = -v[i]; return r; }
+
+	FloatN& operator+=(const FloatN& o) { for (int i = 0; i < N; i++) v[i] += o.v[i]; return *this; }
+	FloatN& operator-=(const FloatN& o) { for (int i = 0; i < N; i++) v[i] -= o.v[i]; return *this; }
+	FloatN& operator*=(const FloatN& o) { for (int i = 0; i < N; i++) v[i] *= o.v[i]; return *this; }
+	FloatN& operator/=(const FloatN& o) { for (int i = 0; i < N; i++) v[i] /= o.v[i]; return *this; }
+
+	MaskN<N> operator==(const FloatN& o) const { MaskN<N> m; for (int i = 0; i < N; i++) m.v[i] = v[i] == o.v[i] ? -1 : 0; return m; }
+	MaskN<N> operator<(const FloatN& o) const { MaskN<N> m; for (int i = 0; i < N; i++) m.v[i] = v[i] < o.v[i] ? -1 : 0; return m; }
+	MaskN<N> operator>(const FloatN& o) const { MaskN<N> m; for (int i = 0; i < N; i++) m.v[i] = v[i] > o.v[i] ? -1 : 0; return m; }
+};
+
+// a where the mask is set, b elsewhere
+template<int N>
+FloatN<N> select(const MaskN<N>& mask, const FloatN<N>& a, const FloatN<N>& b) {
+	FloatN<N> r;
+	for (int i = 0; i < N; i++) r.v[i] = mask.v[i] ? a.v[i] : b.v[i];
+	return r;
+}
+
+// a*b + c, fused when the target has FMA (-mfma / -march=native)
+template<int N>
+FloatN<N> fma(const FloatN<N>& a, const FloatN<N>& b, const FloatN<N>& c) {
+	FloatN<N> r;
+	for (int i = 0; i < N; i++) r.v[i] = a.v[i] * b.v[i] + c.v[i];
+	return r;
+}
+
+template<int N>
+FloatN<N> min(const FloatN<N>& a, const FloatN<N>& b) {
+	FloatN<N> r;
+	for (int i = 0; i < N; i++) r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i];
+	return r;
+}
+
+template<int N>
+FloatN<N> max(const FloatN<N>& a, const FloatN<N>& b) {
+	FloatN<N> r;
+	for (int i = 0; i < N; i++) r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i];
+	return r;
+}
+
+template<int N>
+FloatN<N> sqrt(const FloatN<N>& a) {
+	FloatN<N> r;
+	for (int i = 0; i < N; i++) r.v[i] = std::sqrt(a.v[i]);
+	return r;
+}
+
+// 1/sqrt(a). Lowers to the approximate rsqrt instruction under -ffast-math
+template<int N>
+FloatN<N> rsqrt(const FloatN<N>& a) {
+	FloatN<N> r;
+	for (int i = 0; i < N; i++) r.v[i] = 1.0f / std::sqrt(a.v[i]);
+	return r;
+}
+
+// N Vec2s stored as separate x and y packs, with the same operators as Vec2
+template<int N>
+class Vec2xN {
+	public:
+	FloatN<N> x, y;
+
+	Vec2xN(const FloatN<N>& a = FloatN<N>(), const FloatN<N>& b = FloatN<N>()) : x(a), y(b) {}
+
+	// Broadcasts one Vec2 to every lane
+	Vec2xN(const Vec2& other) : x(other.x), y(other.y) {}
+
+	// Gathers N consecutive Vec2s
+	static Vec2xN load(const Vec2* src) {
+		Vec2xN r;
+		for (int i = 0; i < N; i++) {
+			r.x.v[i] = src[i].x;
+			r.y.v[i] = src[i].y;
+		}
+		return r;
+	}
+
+	// Scatters back to N consecutive Vec2s
+	void store(Vec2* dst) const {
+		for (int i = 0; i < N; i++) {
+			dst[i] = Vec2(x.v[i], y.v[i]);
+		}
+	}
+
+	Vec2 lane(int i) const {
+		return Vec2(x.v[i], y.v[i]);
+	}
+
+	void setLane(int i, const Vec2& value) {
+		x.v[i] = value.x;
+		y.v[i] = value.y;
+	}
+
+	// Operator overloads
+	// Scalar Vector product using operator*, per lane or broadcast
+	Vec2xN operator*(const FloatN<N>& other) const {
+		return Vec2xN(x * other, y * other);
+	}
+
+	// Dot product using operator*
+	FloatN<N> operator*(const Vec2xN& other) const {
+		return fma(x, other.x, y * other.y);
+	}
+
+	// Vec2 addition using operator+
+	Vec2xN operator+(const Vec2xN& other) const {
+		return Vec2xN(x + other.x, y + other.y);
+	}
+
+	// Vec2 += addition using operator+=
+	Vec2xN& operator+=(const Vec2xN& other) {
+		x += other.x;
+		y += other.y;
+		return *this;
+	}
+
+	// Vec2 -= subtraction using operator-=
+	Vec2xN& operator-=(const Vec2xN& other) {
+		x -= other.x;
+		y -= other.y;
+		return *this;
+	}
+
+	// Vec2 subtraction using operator-
+	Vec2xN operator-(const Vec2xN& other) const {
+		return Vec2xN(x - other.x, y - other.y);
+	}
+
+	// Vec2 unary subtraction using operator-
+	Vec2xN operator-() const {
+		return Vec2xN(-x, -y);
+	}
+
+	// Scalar Vector quotient using operator/
+	Vec2xN operator/(const FloatN<N>& other) const {
+		return Vec2xN(x / other, y / other);
+	}
+
+	FloatN<N> magnitude_squared() const {
+		return fma(x, x, y * y);
+	}
+
+	// Unit vectors via rsqrt. Zero length lanes give inf/nan like the scalar maths would
+	Vec2xN normalised() const {
+		return *this * rsqrt(magnitude_squared());
+	}
+};
+
+// Vec2xN a*b + c with a per lane scalar b
+template<int N>
+Vec2xN<N> fma(const Vec2xN<N>& a, const FloatN<N>& b, const Vec2xN<N>& c) {
+	return Vec2xN<N>(fma(a.x, b, c.x), fma(a.y, b, c.y));
+}
+
+typedef FloatN<SIM_LANES> FloatPack;
+typedef Vec2xN<SIM_LANES> Vec2Pack;
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <iostream>
+
+// Minimal checks for the tests: CHECK records a failure and carries on, and
+// each test's main() returns checkResult(), non-zero if anything failed, so
+// ctest sees it
+namespace check {
+	inline int& failures() {
+		static int count = 0;
+		return count;
+	}
+}
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": FAIL: " << #condition << std::endl; \
+			check::failures()++; \
+		} \
+	} while (0)
+
+inline int checkResult() {
+	if (check::failures()) {
+		std::cerr << check::failures() << " check(s) failed" << std::endl;
+		return 1;
+	}
+	return 0;
+}
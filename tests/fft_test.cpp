@@ -0,0 +1,65 @@
+// FFT (fft.h) against a naive double precision DFT, for every power of two
+// up to 4096 so both the scalar and the packed butterfly stages are covered
+
+#include <cmath>
+#include <vector>
+
+#include "fft.h"
+#include "rng.h"
+#include "check.h"
+
+// Largest difference from the DFT, relative to the largest DFT magnitude
+double fftError(int n, Rng &rng) {
+	std::vector<float> re(n), im(n);
+	for (int t = 0; t < n; t++) {
+		re[t] = rng.uniform() * 2 - 1;
+		im[t] = rng.uniform() * 2 - 1;
+	}
+	std::vector<float> outRe = re, outIm = im;
+	FFT(n).forward(outRe.data(), outIm.data());
+
+	double worst = 0, largest = 0;
+	for (int k = 0; k < n; k++) {
+		double sumRe = 0, sumIm = 0;
+		for (int t = 0; t < n; t++) {
+			// k * t mod n keeps the angle exact for large n
+			double angle = -2 * M_PI * (double)((long long)k * t % n) / n;
+			sumRe += re[t] * cos(angle) - im[t] * sin(angle);
+			sumIm += re[t] * sin(angle) + im[t] * cos(angle);
+		}
+		worst = std::max(worst, std::hypot(outRe[k] - sumRe, outIm[k] - sumIm));
+		largest = std::max(largest, std::hypot(sumRe, sumIm));
+	}
+	return worst / largest;
+}
+
+void testAgainstDFT() {
+	Rng rng(1, 2);
+	for (int n = 1; n <= 4096; n *= 2) {
+		// float rounding grows with the log2(n) stages
+		double bound = 1e-6 * (std::log2((double)n) + 1);
+		double error = fftError(n, rng);
+		if (!(error <= bound)) std::cerr << "n = " << n << ": relative error " << error << std::endl;
+		CHECK(error <= bound);
+	}
+}
+
+void testImpulse() {
+	// an impulse at t = 1 is the twiddle sequence e^(-2 pi i k / n)
+	const int n = 64;
+	std::vector<float> re(n, 0), im(n, 0);
+	re[1] = 1;
+	FFT(n).forward(re.data(), im.data());
+	for (int k = 0; k < n; k++) {
+		CHECK(fabs(re[k] - cos(2 * M_PI * k / n)) < 1e-6);
+		CHECK(fabs(im[k] + sin(2 * M_PI * k / n)) < 1e-6);
+	}
+}
+
+int main() {
+	CHECK(FFT::isPowerOfTwo(1) && FFT::isPowerOfTwo(4096));
+	CHECK(!FFT::isPowerOfTwo(0) && !FFT::isPowerOfTwo(12) && !FFT::isPowerOfTwo(-8));
+	testAgainstDFT();
+	testImpulse();
+	return checkResult();
+}
@@ -0,0 +1,53 @@
+// Run metrics (metrics.h): rise time runs from 10% to 90% of the step, and a
+// rebase restarts the step response without restarting the cost integrals
+
+#include <algorithm>
+#include <cmath>
+
+#include "metrics.h"
+#include "check.h"
+
+const float DT = 0.01f;
+
+// Moves from (0, 0) to (100, 0) at 100 px/s, then holds
+Vec2 ramp(double time) {
+	return Vec2((float)std::min(time, 1.0) * 100, 0);
+}
+
+void testRiseTime() {
+	RunMetrics metrics;
+	for (int step = 0; step <= 200; step++) {
+		double time = step * DT;
+		metrics.update(time, Vec2(100, 0), ramp(time), Vec2(0, 0), DT);
+	}
+	// 10 px at 0.1 s to 90 px at 0.9 s
+	CHECK(fabsf(metrics.riseTime - 0.8f) < 1.5f * DT);
+	CHECK(metrics.settlingTime >= 0);
+	CHECK(metrics.overshoot == 0);
+}
+
+void testRebaseKeepsIntegrals() {
+	// the same error trace, with and without a target jump half way that
+	// only moves the reference
+	RunMetrics steady, jumped;
+	for (int step = 0; step < 100; step++) {
+		double time = 5 + step * DT;
+		Vec2 target = step < 50 ? Vec2(100, 0) : Vec2(0, 100);
+		Vec2 pos = target - Vec2(10, 0);
+		steady.update(time, Vec2(100, 0), Vec2(90, 0), Vec2(1, 0), DT);
+		jumped.update(time, target, pos, Vec2(1, 0), DT);
+	}
+	CHECK(jumped.startTime > steady.startTime);
+	CHECK(jumped.ise == steady.ise);
+	CHECK(jumped.iae == steady.iae);
+	CHECK(jumped.effort == steady.effort);
+	// time weighted from the first update, not from the rebase
+	CHECK(jumped.itae == steady.itae);
+	CHECK(fabs(steady.itae - 10 * 0.495) < 1e-3);
+}
+
+int main() {
+	testRiseTime();
+	testRebaseKeepsIntegrals();
+	return checkResult();
+}
@@ -0,0 +1,113 @@
+// Sensor noise (noise.h): every kind has mean 0 and standard deviation
+// sigma, Gaussian and uniform samples have their distribution's kurtosis,
+// DRIFT's bias wanders as a random walk and channels are independent
+
+#include <cmath>
+#include <vector>
+
+#include "noise.h"
+#include "check.h"
+
+const float DT = 1.0f / 120;
+
+struct Moments {
+	double mean = 0, deviation = 0, kurtosis = 0;
+};
+
+// Moments over every channel of steps steps, after warmUp steps unrecorded
+Moments sample(SensorNoise::Kind kind, size_t channels, int steps, int warmUp = 0) {
+	SensorNoise noise;
+	noise.kind = kind;
+	noise.seed(7);
+	noise.resize(channels);
+	std::vector<float> out(channels);
+	for (int step = 0; step < warmUp; step++) noise.fill(out.data(), DT);
+	double sum = 0, sum2 = 0, sum4 = 0, count = (double)channels * steps;
+	std::vector<double> values;
+	values.reserve((size_t)count);
+	for (int step = 0; step < steps; step++) {
+		noise.fill(out.data(), DT);
+		for (float x : out) {
+			values.push_back(x);
+			sum += x;
+		}
+	}
+	Moments m;
+	m.mean = sum / count;
+	for (double x : values) {
+		sum2 += (x - m.mean) * (x - m.mean);
+		sum4 += (x - m.mean) * (x - m.mean) * (x - m.mean) * (x - m.mean);
+	}
+	m.deviation = sqrt(sum2 / count);
+	m.kurtosis = sum4 / count / (sum2 / count * sum2 / count);
+	return m;
+}
+
+void testWhite() {
+	const float sigma = SensorNoise().sigma;
+	// 409600 samples: the mean's own spread is sigma / 640
+	Moments gaussian = sample(SensorNoise::GAUSSIAN, 4096, 100);
+	CHECK(fabs(gaussian.mean) < sigma * 0.01);
+	CHECK(fabs(gaussian.deviation / sigma - 1) < 0.01);
+	CHECK(fabs(gaussian.kurtosis - 3) < 0.05);
+
+	Moments uniform = sample(SensorNoise::UNIFORM, 4096, 100);
+	CHECK(fabs(uniform.mean) < sigma * 0.01);
+	CHECK(fabs(uniform.deviation / sigma - 1) < 0.01);
+	CHECK(fabs(uniform.kurtosis - 1.8) < 0.02);
+}
+
+void testPink() {
+	// the slowest pole takes a few thousand steps to reach its stationary spread
+	const float sigma = SensorNoise().sigma;
+	Moments pink = sample(SensorNoise::PINK, 1024, 400, 4000);
+	CHECK(fabs(pink.mean) < sigma * 0.05);
+	CHECK(fabs(pink.deviation / sigma - 1) < 0.05);
+}
+
+void testDrift() {
+	// after t seconds each channel's bias has spread driftRate * sqrt(t)
+	SensorNoise noise;
+	noise.kind = SensorNoise::DRIFT;
+	const size_t channels = 4096;
+	const int steps = 1200;
+	noise.resize(channels);
+	std::vector<float> out(channels);
+	for (int step = 0; step < steps; step++) noise.fill(out.data(), DT);
+	double sum2 = 0;
+	for (float b : noise.bias) sum2 += (double)b * b;
+	double spread = sqrt(sum2 / channels);
+	double expected = noise.driftRate * sqrt(steps * DT);
+	CHECK(fabs(spread / expected - 1) < 0.05);
+}
+
+void testIndependentChannels() {
+	// neighbouring channels, and one channel from step to step, are uncorrelated
+	SensorNoise noise;
+	noise.kind = SensorNoise::GAUSSIAN;
+	const size_t channels = 256;
+	const int steps = 2000;
+	noise.resize(channels);
+	std::vector<float> out(channels), last(channels);
+	double across = 0, along = 0, sum2 = 0;
+	for (int step = 0; step < steps; step++) {
+		noise.fill(out.data(), DT);
+		for (size_t c = 0; c < channels; c++) {
+			sum2 += (double)out[c] * out[c];
+			if (c > 0) across += (double)out[c] * out[c - 1];
+			if (step > 0) along += (double)out[c] * last[c];
+		}
+		last = out;
+	}
+	// correlations are within a few times 1 / sqrt(samples) = 0.0014 of 0
+	CHECK(fabs(across / sum2) < 0.01);
+	CHECK(fabs(along / sum2) < 0.01);
+}
+
+int main() {
+	testWhite();
+	testPink();
+	testDrift();
+	testIndependentChannels();
+	return checkResult();
+}
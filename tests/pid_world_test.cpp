@@ -0,0 +1,109 @@
+// The PID-Controller-world library (pid_world.h): every call refuses bad
+// arguments with PID_WORLD_ERROR_ARGUMENT and leaves the world as it was
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "pid_world.h"
+#include "check.h"
+
+const size_t AGENTS = 21; // not a whole number of blocks
+
+// Positions, velocities and errors of every agent
+std::vector<float> state(const PidWorld* world) {
+	size_t n = pid_world_agent_count(world);
+	std::vector<float> all(6 * n);
+	CHECK(pid_world_read_state(world, 0, n, &all[0], &all[2 * n], &all[4 * n]) == PID_WORLD_OK);
+	return all;
+}
+
+PidWorld* makeWorld() {
+	PidWorld* world = pid_world_create();
+	std::vector<float> positions(2 * AGENTS);
+	for (size_t k = 0; k < positions.size(); k++) positions[k] = 100.0f + 7 * k;
+	CHECK(pid_world_add_agents(world, AGENTS, positions.data()) == 0);
+	CHECK(pid_world_set_target(world, 300, 200) == PID_WORLD_OK);
+	CHECK(pid_world_step(world, 30, 1.0f / 120) == PID_WORLD_OK);
+	return world;
+}
+
+void testNullWorld() {
+	float buffer[2] = {0, 0};
+	PidGains gains = {0.25f, 0.1f, 0.1f};
+	CHECK(pid_world_add_agents(nullptr, 1, buffer) == PID_WORLD_ERROR_ARGUMENT);
+	CHECK(pid_world_agent_count(nullptr) == 0);
+	CHECK(pid_world_set_gains(nullptr, 0, 0, &gains) == PID_WORLD_ERROR_ARGUMENT);
+	CHECK(pid_world_set_target(nullptr, 1, 2) == PID_WORLD_ERROR_ARGUMENT);
+	CHECK(pid_world_set_targets(nullptr, 0, 0, buffer) == PID_WORLD_ERROR_ARGUMENT);
+	CHECK(pid_world_step(nullptr, 1, 1.0f / 120) == PID_WORLD_ERROR_ARGUMENT);
+	CHECK(pid_world_read_state(nullptr, 0, 0, buffer, buffer, buffer) == PID_WORLD_ERROR_ARGUMENT);
+	pid_world_destroy(nullptr);
+}
+
+void testRefusedCallsChangeNothing() {
+	PidWorld* world = makeWorld();
+	const std::vector<float> before = state(world);
+	std::vector<float> buffer(2 * (AGENTS + 1), 1);
+	std::vector<PidGains> gains(AGENTS + 1, PidGains{1, 1, 1});
+	const float inf = std::numeric_limits<float>::infinity();
+	const float nan = std::numeric_limits<float>::quiet_NaN();
+
+	// agent ranges past the end, including ones whose end wraps around
+	CHECK(pid_world_set_gains(world, 0, AGENTS + 1, gains.data()) == PID_WORLD_ERROR_ARGUMENT);
+	CHECK(pid_world_set_gains(world, AGENTS + 1, 0, gains.data()) == PID_WORLD_ERROR_ARGUMENT);
+	CHECK(pid_world_set_gains(world, 1, SIZE_MAX, gains.data()) == PID_WORLD_ERROR_ARGUMENT);
+	CHECK(pid_world_set_targets(world, AGENTS, 1, buffer.data()) == PID_WORLD_ERROR_ARGUMENT);
+	CHECK(pid_world_set_targets(world, SIZE_MAX, 2, buffer.data()) == PID_WORLD_ERROR_ARGUMENT);
+	CHECK(pid_world_read_state(world, AGENTS - 1, 2, buffer.data(), nullptr, nullptr) == PID_WORLD_ERROR_ARGUMENT);
+	CHECK(pid_world_read_state(world, 2, SIZE_MAX - 1, buffer.data(), nullptr, nullptr) == PID_WORLD_ERROR_ARGUMENT);
+
+	// missing arrays for a non-empty range
+	CHECK(pid_world_set_gains(world, 0, 1, nullptr) == PID_WORLD_ERROR_ARGUMENT);
+	CHECK(pid_world_set_targets(world, 0, 1, nullptr) == PID_WORLD_ERROR_ARGUMENT);
+
+	// time steps that aren't positive and finite
+	for (float dt : {0.0f, -1.0f / 120, inf, -inf, nan}) {
+		CHECK(pid_world_step(world, 1, dt) == PID_WORLD_ERROR_ARGUMENT);
+	}
+
+	// more agents than can be numbered or held
+	CHECK(pid_world_add_agents(world, SIZE_MAX, nullptr) == PID_WORLD_ERROR_ARGUMENT);
+	CHECK(pid_world_add_agents(world, SIZE_MAX - AGENTS + 1, nullptr) == PID_WORLD_ERROR_ARGUMENT);
+	int64_t huge = pid_world_add_agents(world, (size_t)1 << 60, nullptr);
+	CHECK(huge == PID_WORLD_ERROR_ARGUMENT || huge == PID_WORLD_ERROR_MEMORY);
+
+	CHECK(pid_world_agent_count(world) == AGENTS);
+	CHECK(state(world) == before);
+
+	// the same step as a fresh world's shows the gains and targets are untouched
+	PidWorld* reference = makeWorld();
+	CHECK(pid_world_step(world, 10, 1.0f / 120) == PID_WORLD_OK);
+	CHECK(pid_world_step(reference, 10, 1.0f / 120) == PID_WORLD_OK);
+	CHECK(state(world) == state(reference));
+	pid_world_destroy(reference);
+	pid_world_destroy(world);
+}
+
+void testEmptyRanges() {
+	// empty ranges are fine anywhere up to the end, with or without arrays
+	PidWorld* world = makeWorld();
+	const std::vector<float> before = state(world);
+	CHECK(pid_world_set_gains(world, AGENTS, 0, nullptr) == PID_WORLD_OK);
+	CHECK(pid_world_set_targets(world, 0, 0, nullptr) == PID_WORLD_OK);
+	CHECK(pid_world_read_state(world, AGENTS, 0, nullptr, nullptr, nullptr) == PID_WORLD_OK);
+	CHECK(pid_world_step(world, 0, 1.0f / 120) == PID_WORLD_OK);
+	CHECK(pid_world_add_agents(world, 0, nullptr) == (int64_t)AGENTS);
+	CHECK(state(world) == before);
+	pid_world_destroy(world);
+}
+
+int main() {
+	CHECK(pid_world_abi_version() == PID_WORLD_ABI_VERSION);
+	testNullWorld();
+	testRefusedCallsChangeNothing();
+	testEmptyRanges();
+	return checkResult();
+}
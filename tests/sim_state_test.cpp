@@ -0,0 +1,139 @@
+// Snapshots (sim_state.h): saving and loading continues a run bit for bit,
+// and truncated, bit-flipped or out-of-range snapshots are refused or, where
+// the bytes are still a usable state, load into something safe to step
+
+#include <cstring>
+#include <vector>
+
+#include "sim_state.h"
+#include "check.h"
+
+// A run using every part of the state: stage rates with a sensor delay,
+// coloured noise and a target that jumps
+Simulation warmedUp() {
+	Simulation sim;
+	sim.setGains(PIDGains());
+	StageRates rates;
+	rates.sensorPeriod = 1.0f / 200;
+	rates.controlPeriod = 1.0f / 50;
+	rates.sensorDelay = 3;
+	sim.setRates(rates);
+	sim.noise.kind = SensorNoise::PINK;
+	for (int step = 0; step < 500; step++) {
+		sim.step(step < 250 ? Vec2(300, 200) : Vec2(700, 500), SIM_DT);
+	}
+	return sim;
+}
+
+void run(Simulation &sim, int steps) {
+	for (int step = 0; step < steps; step++) sim.step(Vec2(500, 400), SIM_DT);
+}
+
+bool sameState(const Simulation &a, const Simulation &b) {
+	std::vector<uint8_t> stateA, stateB;
+	saveState(a, stateA);
+	saveState(b, stateB);
+	return stateA == stateB;
+}
+
+void testRoundTrip() {
+	Simulation original = warmedUp();
+	std::vector<uint8_t> state;
+	saveState(original, state);
+
+	Simulation restored;
+	CHECK(loadState(restored, state));
+	CHECK(sameState(original, restored));
+	run(original, 300);
+	run(restored, 300);
+	CHECK(original.agent.pos.x == restored.agent.pos.x && original.agent.pos.y == restored.agent.pos.y);
+	CHECK(original.metrics.itae == restored.metrics.itae);
+	CHECK(sameState(original, restored));
+
+	// padding never reaches the file, so equal states save equal bytes
+	std::vector<uint8_t> again;
+	saveState(warmedUp(), again);
+	CHECK(again == state);
+}
+
+void testTruncated() {
+	std::vector<uint8_t> state;
+	saveState(warmedUp(), state);
+	for (size_t size = 0; size < state.size(); size++) {
+		Simulation sim;
+		std::vector<uint8_t> before;
+		saveState(sim, before);
+		CHECK(!loadState(sim, state.data(), size));
+		CHECK(sameState(sim, Simulation()));
+	}
+	state.push_back(0);
+	Simulation sim;
+	CHECK(!loadState(sim, state));
+}
+
+// Every single bit flip either fails to load or gives a state that steps
+// without touching memory it shouldn't (run under a sanitiser to see it)
+void testBitFlips() {
+	std::vector<uint8_t> state;
+	saveState(warmedUp(), state);
+	int loaded = 0;
+	for (size_t bit = 0; bit < state.size() * 8; bit++) {
+		std::vector<uint8_t> flipped = state;
+		flipped[bit / 8] ^= (uint8_t)(1 << (bit % 8));
+		Simulation sim;
+		if (!loadState(sim, flipped)) continue;
+		loaded++;
+		CHECK(sim.multiRate.readings.head <= StageRates::MAX_SENSOR_DELAY);
+		CHECK(sim.noise.streams.buffered <= (uint32_t)noise::Streams::STREAMS);
+		run(sim, 2);
+	}
+	CHECK(loaded > 0); // most bits are just numbers
+}
+
+// Each field that indexes or selects something, set out of range
+void testOutOfRange() {
+	auto refused = [](void (*spoil)(Simulation&)) {
+		Simulation sim = warmedUp();
+		spoil(sim);
+		std::vector<uint8_t> state;
+		saveState(sim, state);
+		Simulation target;
+		return !loadState(target, state);
+	};
+	CHECK(refused([](Simulation &sim) { sim.multiRate.readings.head = StageRates::MAX_SENSOR_DELAY + 1; }));
+	CHECK(refused([](Simulation &sim) { sim.multiRate.rates.sensorDelay = -1; }));
+	CHECK(refused([](Simulation &sim) { sim.multiRate.scheduler.events[0].stage = MultiRateState::STAGES; }));
+	CHECK(refused([](Simulation &sim) { sim.multiRate.scheduler.events[1].stage = sim.multiRate.scheduler.events[0].stage; }));
+	CHECK(refused([](Simulation &sim) { sim.multiRate.scheduler.periods[2] = 0; }));
+	CHECK(refused([](Simulation &sim) { sim.multiRate.periods[0] = -1; }));
+	CHECK(refused([](Simulation &sim) { sim.multiRate.scheduler.events[0].time -= 1000000000; }));
+	CHECK(refused([](Simulation &sim) { sim.multiRate.clock += 1000000000; }));
+	CHECK(refused([](Simulation &sim) { sim.noise.streams.buffered = noise::Streams::STREAMS + 1; }));
+	CHECK(refused([](Simulation &sim) { sim.noise.kind = (SensorNoise::Kind)7; }));
+	CHECK(refused([](Simulation &sim) { sim.integrator.tolerance = 0; }));
+	CHECK(!refused([](Simulation &) {}));
+
+	// an enum can't hold an out of range value without undefined behaviour,
+	// so find where the integrator is stored and write one into the bytes
+	Simulation sim = warmedUp();
+	std::vector<uint8_t> discrete, rk4;
+	saveState(sim, discrete);
+	sim.integrator.kind = Integrator::RK4;
+	saveState(sim, rk4);
+	size_t at = 0;
+	while (at < discrete.size() && discrete[at] == rk4[at]) at++;
+	CHECK(at < discrete.size());
+	for (int32_t kind : {-1, (int32_t)Integrator::DORMAND_PRINCE + 1}) {
+		memcpy(&discrete[at], &kind, sizeof(kind));
+		Simulation target;
+		CHECK(!loadState(target, discrete));
+	}
+}
+
+int main() {
+	testRoundTrip();
+	testTruncated();
+	testBitFlips();
+	testOutOfRange();
+	return checkResult();
+}
@@ -0,0 +1,85 @@
+// TiledHeatmap (tiled_heatmap.h): after any sequence of added and moved
+// lights, what update() uploads matches generating the whole field again
+// from scratch, texel for texel, and uploads stay inside the field
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "tiled_heatmap.h"
+#include "rng.h"
+#include "check.h"
+
+// Every texel of a width x height field from all of lights at once
+std::vector<uint32_t> regenerate(const HeatmapParams &params, const std::vector<Vec2> &lights,
+	const Vec2 &origin, float worldPerTexel, int width, int height) {
+	std::vector<int> which(lights.size());
+	for (size_t l = 0; l < lights.size(); l++) which[l] = (int)l;
+	std::vector<uint32_t> pixels((size_t)width * height);
+	generateHeatmapRegion(params, lights.data(), which.data(), (int)lights.size(), origin, worldPerTexel,
+		0, 0, width, height, pixels.data(), width);
+	return pixels;
+}
+
+// Field sizes that are and aren't whole tiles, lit texels every sampleStep
+void testMatchesRegeneration(int width, int height, int sampleStep) {
+	HeatmapParams params;
+	params.sampleStep = sampleStep;
+	params.maxDistance = 150;
+	const Vec2 origin(-40, -25);
+	const float worldPerTexel = 1.5f;
+	TiledHeatmap field(params, origin, worldPerTexel, width, height);
+
+	// a texture of exactly the field's size, fed only through upload
+	std::vector<uint32_t> texture((size_t)width * height, 0xdeadbeef);
+	bool inside = true;
+	auto upload = [&](const TileRect &rect, const uint32_t* pixels, int pitch) {
+		inside = inside && rect.x >= 0 && rect.y >= 0 && rect.w > 0 && rect.h > 0
+			&& rect.x + rect.w <= width && rect.y + rect.h <= height;
+		if (!inside) return;
+		for (int y = 0; y < rect.h; y++) {
+			const uint32_t* row = (const uint32_t*)((const uint8_t*)pixels + (size_t)y * pitch);
+			for (int x = 0; x < rect.w; x++) texture[(size_t)(rect.y + y) * width + rect.x + x] = row[x];
+		}
+	};
+
+	Rng rng(3, 4);
+	Vec2 extent = Vec2((float)width, (float)height) * worldPerTexel;
+	auto anywhere = [&]() {
+		// including a margin off the field, whose light still reaches in
+		return origin + Vec2(rng.uniform(-0.2f, 1.2f) * extent.x, rng.uniform(-0.2f, 1.2f) * extent.y);
+	};
+	std::vector<Vec2> lights;
+	field.update(upload);
+	CHECK(texture == regenerate(params, lights, origin, worldPerTexel, width, height));
+
+	for (int round = 0; round < 30; round++) {
+		if (round % 5 == 0) {
+			lights.push_back(anywhere());
+			CHECK(field.addLight(lights.back()) == (int)lights.size() - 1);
+		}
+		int light = (int)(rng.next() % lights.size());
+		// small moves that stay within a tile and jumps across the field
+		lights[light] = round % 2 ? lights[light] + Vec2(rng.uniform(-3, 3), rng.uniform(-3, 3)) : anywhere();
+		field.moveLight(light, lights[light]);
+		field.update(upload);
+		CHECK(field.dirtyCount() == 0);
+		std::vector<uint32_t> expected = regenerate(params, lights, origin, worldPerTexel, width, height);
+		CHECK(texture == expected);
+		CHECK(std::equal(expected.begin(), expected.end(), field.pixels()));
+	}
+	CHECK(inside);
+
+	// a move to where the light already is dirties nothing
+	uint64_t before = field.tilesUpdated;
+	field.moveLight(0, lights[0]);
+	field.update(upload);
+	CHECK(field.tilesUpdated == before);
+}
+
+int main() {
+	testMatchesRegeneration(256, 192, 1);
+	testMatchesRegeneration(300, 130, 5);
+	testMatchesRegeneration(63, 65, 2);
+	return checkResult();
+}